@@ -0,0 +1,229 @@
+#!/usr/bin/env python3
+"""
+generate.py: make a synthetic reference-plus-bubbles graph and a matching Glenn
+call file, for benchmarking glenn2vcf.
+
+Writes PREFIX.json (a vg graph in JSON, for "vg view -Jv") and PREFIX.tsv (the
+Glenn calls). The same seed and scale always give the same files.
+
+The graph is a single reference path named "ref", chopped into short nodes,
+with variant sites hung off it every so often. Sites can be SNPs, small
+insertions and deletions, long deletions, nested bubbles, or tangled regions
+with extra edges between alt nodes and backward-traversed alt nodes.
+"""
+
+import argparse
+import json
+import random
+import sys
+
+# What kinds of sites can we make, and how often?
+SITE_WEIGHTS = [
+    ("snp", 50),
+    ("insertion", 15),
+    ("deletion", 15),
+    ("long_deletion", 5),
+    ("nested", 10),
+    ("tangle", 5),
+]
+
+def parse_args(args):
+    parser = argparse.ArgumentParser(description=__doc__,
+        formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("prefix",
+        help="write PREFIX.json and PREFIX.tsv")
+    parser.add_argument("--sites", type=int, default=1000,
+        help="number of variant sites to make")
+    parser.add_argument("--spacing", type=int, default=200,
+        help="average reference bases between sites")
+    parser.add_argument("--max_node", type=int, default=32,
+        help="longest reference node to make")
+    parser.add_argument("--coverage", type=int, default=30,
+        help="average read support for reference nodes")
+    parser.add_argument("--seed", type=int, default=1,
+        help="seed for the random number generator")
+    return parser.parse_args(args[1:])
+
+class GraphBuilder(object):
+    """
+    Accumulates the nodes, edges, reference path and calls for the graph.
+    """
+    
+    def __init__(self, options):
+        self.options = options
+        self.rng = random.Random(options.seed)
+        # Node records as (id, sequence)
+        self.nodes = []
+        # Edges as (from, from_start, to, to_end)
+        self.edges = []
+        # Node IDs along the reference path
+        self.reference = []
+        # Call lines for the TSV, by node and by edge
+        self.node_calls = []
+        self.edge_calls = []
+        self.next_id = 1
+        
+    def sequence(self, length):
+        return "".join(self.rng.choice("ACGT") for _ in range(length))
+        
+    def support(self, mean):
+        """
+        Get a forward, reverse read support pair around the given mean.
+        """
+        total = max(0, int(self.rng.gauss(mean, mean ** 0.5))) if mean > 0 else 0
+        forward = self.rng.randint(0, total)
+        return forward, total - forward
+        
+    def likelihood(self):
+        return -self.rng.random() * 3
+        
+    def add_node(self, length, call_type, mean_support):
+        node_id = self.next_id
+        self.next_id += 1
+        self.nodes.append((node_id, self.sequence(length)))
+        forward, reverse = self.support(mean_support)
+        # Every node is its own original node, at offset 0
+        self.node_calls.append("N\t{}\t{}\t{}\t{}\t0\t{:.3f}\t{}\t0".format(
+            node_id, call_type, forward, reverse, self.likelihood(), node_id))
+        return node_id
+        
+    def add_edge(self, from_id, to_id, mode, mean_support, from_start=False, to_end=False):
+        self.edges.append((from_id, from_start, to_id, to_end))
+        forward, reverse = self.support(mean_support)
+        self.edge_calls.append("E\t{},{},{},{}\t{}\t{}\t{}\t0\t{:.3f}".format(
+            from_id, int(from_start), to_id, int(to_end), mode, forward, reverse,
+            self.likelihood()))
+        
+    def add_reference(self, length):
+        """
+        Extend the reference by a run of nodes totalling about the given length.
+        Returns the list of new node IDs.
+        """
+        added = []
+        while length > 0:
+            node_length = min(length, self.rng.randint(1, self.options.max_node))
+            added.append(self.add_reference_node(node_length))
+            length -= node_length
+        return added
+        
+    def add_reference_node(self, length):
+        node_id = self.add_node(length, "R", self.options.coverage)
+        if self.reference:
+            self.add_edge(self.reference[-1], node_id, "R", self.options.coverage)
+        self.reference.append(node_id)
+        return node_id
+        
+    def alt_support(self):
+        """
+        Pick how much support an alt gets: hom alt, het or absent.
+        """
+        return self.options.coverage * self.rng.choice([1.0, 0.5, 0.5, 0.0])
+        
+    def add_alt_chain(self, lengths, mean_support, start, end, backward=False):
+        """
+        Thread a chain of alt nodes of the given lengths from start to end.
+        Returns the new node IDs.
+        """
+        chain = [self.add_node(length, "S", mean_support) for length in lengths]
+        previous = start
+        previous_backward = False
+        for node_id in chain:
+            self.add_edge(previous, node_id, "N", mean_support,
+                from_start=previous_backward, to_end=backward)
+            previous = node_id
+            previous_backward = backward
+        self.add_edge(previous, end, "N", mean_support, from_start=previous_backward)
+        return chain
+        
+    def add_site(self, kind):
+        coverage = self.options.coverage
+        before = self.reference[-1]
+        
+        if kind == "snp":
+            # One base in the reference and one alternative
+            self.add_reference_node(1)
+            after = self.add_reference_node(self.rng.randint(1, self.options.max_node))
+            self.add_alt_chain([1], self.alt_support(), before, after)
+            
+        elif kind == "insertion":
+            # Novel sequence between two adjacent reference nodes
+            after = self.add_reference_node(self.rng.randint(1, self.options.max_node))
+            self.add_alt_chain([self.rng.randint(1, 20)], self.alt_support(), before, after)
+            
+        elif kind == "deletion" or kind == "long_deletion":
+            # An edge skipping some reference material
+            if kind == "deletion":
+                deleted = self.add_reference(self.rng.randint(1, 10))
+            else:
+                deleted = self.add_reference(self.rng.randint(50, 2000))
+            after = self.add_reference_node(self.rng.randint(1, self.options.max_node))
+            self.add_edge(before, after, "L", self.alt_support())
+            
+        elif kind == "nested":
+            # A replacement whose alt has its own SNP in the middle
+            self.add_reference(self.rng.randint(5, 40))
+            after = self.add_reference_node(self.rng.randint(1, self.options.max_node))
+            support = self.alt_support()
+            left, middle, right = self.add_alt_chain(
+                [self.rng.randint(1, 10), 1, self.rng.randint(1, 10)], support, before, after)
+            # Hang an alternative base off the alt path
+            self.add_alt_chain([1], support / 2, left, right)
+            
+        elif kind == "tangle":
+            # Several alt paths through the same region, cross-linked, some
+            # traversing nodes backward
+            self.add_reference(self.rng.randint(20, 100))
+            after = self.add_reference_node(self.rng.randint(1, self.options.max_node))
+            chains = []
+            for _ in range(self.rng.randint(2, 4)):
+                lengths = [self.rng.randint(1, 8) for _ in range(self.rng.randint(1, 4))]
+                chains.append(self.add_alt_chain(lengths, self.alt_support(), before, after,
+                    backward=self.rng.random() < 0.3))
+            for _ in range(self.rng.randint(1, 6)):
+                # Cross-link alt nodes
+                a = self.rng.choice(self.rng.choice(chains))
+                b = self.rng.choice(self.rng.choice(chains))
+                if a != b:
+                    self.add_edge(a, b, "N", self.rng.choice([0, coverage / 4]))
+        else:
+            raise RuntimeError("Unknown site kind " + kind)
+            
+    def to_json(self):
+        return {
+            "node": [{"id": node_id, "sequence": sequence} for node_id, sequence in self.nodes],
+            "edge": [dict([("from", f), ("to", t)] +
+                ([("from_start", True)] if fs else []) +
+                ([("to_end", True)] if te else [])) for f, fs, t, te in self.edges],
+            "path": [{
+                "name": "ref",
+                "mapping": [{"position": {"node_id": node_id}, "rank": rank + 1}
+                    for rank, node_id in enumerate(self.reference)]
+            }]
+        }
+
+def main(args):
+    options = parse_args(args)
+    builder = GraphBuilder(options)
+    
+    kinds = [kind for kind, _ in SITE_WEIGHTS]
+    weights = [weight for _, weight in SITE_WEIGHTS]
+    
+    builder.add_reference(options.spacing)
+    for _ in range(options.sites):
+        builder.add_site(builder.rng.choices(kinds, weights)[0])
+        builder.add_reference(builder.rng.randint(options.spacing // 2, options.spacing * 3 // 2))
+    
+    with open(options.prefix + ".json", "w") as stream:
+        json.dump(builder.to_json(), stream)
+        stream.write("\n")
+        
+    with open(options.prefix + ".tsv", "w") as stream:
+        for line in builder.node_calls + builder.edge_calls:
+            stream.write(line + "\n")
+            
+    sys.stderr.write("Made {} nodes, {} edges and {} sites\n".format(
+        len(builder.nodes), len(builder.edges), options.sites))
+    return 0
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv))
@@ -0,0 +1,64 @@
+#!/usr/bin/env bash
+# run.sh: time each phase of glenn2vcf on synthetic graphs at several scales.
+#
+# Usage: bench/run.sh [SITES ...]
+#
+# For each number of sites (default 1000 10000 100000), makes a graph and call
+# file with generate.py, converts the graph with vg, and runs glenn2vcf on it
+# REPEATS times. Prints the best time for each phase, as tab-separated sites,
+# phase and seconds lines.
+#
+# Environment variables:
+#   GLENN2VCF   glenn2vcf binary to time (default ./glenn2vcf)
+#   VG          vg binary used to convert graphs (default ekg/vg/bin/vg)
+#   WORK        where to keep generated inputs and outputs (default bench/work)
+#   SEED        generator seed (default 1)
+#   REPEATS     runs per scale (default 3)
+#   EXTRA_ARGS  more options to pass to glenn2vcf
+
+set -e
+
+cd "$(dirname "$0")/.."
+
+GLENN2VCF="${GLENN2VCF:-./glenn2vcf}"
+VG="${VG:-ekg/vg/bin/vg}"
+WORK="${WORK:-bench/work}"
+SEED="${SEED:-1}"
+REPEATS="${REPEATS:-3}"
+
+if [ "$#" -gt 0 ]; then
+    SCALES="$@"
+else
+    SCALES="1000 10000 100000"
+fi
+
+mkdir -p "${WORK}"
+
+printf "sites\tphase\tseconds\n"
+
+for SITES in ${SCALES}; do
+    PREFIX="${WORK}/sites${SITES}_seed${SEED}"
+    
+    if [ ! -e "${PREFIX}.vg" ] || [ ! -e "${PREFIX}.tsv" ]; then
+        # Make the inputs for this scale. They only depend on the scale and
+        # seed, so we can reuse them between runs.
+        python3 bench/generate.py --sites "${SITES}" --seed "${SEED}" "${PREFIX}" 1>&2
+        "${VG}" view -Jv "${PREFIX}.json" > "${PREFIX}.vg"
+    fi
+    
+    for RUN in $(seq 1 "${REPEATS}"); do
+        START=$(date +%s.%N)
+        "${GLENN2VCF}" -T -r ref ${EXTRA_ARGS} "${PREFIX}.vg" "${PREFIX}.tsv" \
+            > "${PREFIX}.vcf" 2> "${PREFIX}.log"
+        END=$(date +%s.%N)
+        
+        # Pull out the phase times, and add the whole run's wall clock time
+        sed -n 's/^Phase \([^ ]*\) took \([^ ]*\) seconds\.$/\1\t\2/p' "${PREFIX}.log"
+        awk -v start="${START}" -v end="${END}" 'BEGIN { printf "total\t%f\n", end - start }'
+    done | awk -v sites="${SITES}" -F '\t' '
+        # Keep the best time for each phase, in the order phases first appear
+        !($1 in best) { order[++count] = $1; best[$1] = $2 }
+        $2 < best[$1] { best[$1] = $2 }
+        END { for(i = 1; i <= count; i++) printf "%s\t%s\t%s\n", sites, order[i], best[order[i]] }
+    '
+done
@@ -0,0 +1,4574 @@
+// glenn2vcf.cpp: Implementation of the Glenn-to-VCF calling library
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <regex>
+#include <set>
+#include <unordered_map>
+#include <utility>
+#include <algorithm>
+#include <deque>
+#include <queue>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <limits>
+#include <cstring>
+#include <omp.h>
+#include <zlib.h>
+#include <unistd.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "glenn2vcf.hpp"
+#include "ekg/vg/src/vg.hpp"
+#include "ekg/vg/src/index.hpp"
+#include "ekg/vg/deps/vcflib/src/Variant.h"
+#include "htslib/vcf.h"
+
+
+// TODO:
+//  - Decide if we need to have sibling alts detect (somehow) and coordinate with each other
+//  - Parallelize variant generation
+//  - Make variant stamping out some kind of function, don't duplicate the same variant construction code 6 times
+
+// How many bases may we put in an allele in VCF if we expect GATK to be able to
+// parse it?
+// 0 means no maximum is enforced.
+const static int MAX_ALLELE_LENGTH = 0;
+
+// convert to string using stringstream (to replace to_string when we want sci. notation)
+template <typename T>
+static std::string to_string_ss(T val) {
+    stringstream ss;
+    ss << val;
+    return ss.str();
+}
+
+// Write a plain-old-data value to a binary stream in native byte order
+template <typename T>
+static void write_binary(std::ostream& out, const T& val) {
+    out.write((const char*)&val, sizeof(T));
+}
+
+// Read a plain-old-data value from a binary stream, returning false if we ran
+// out of data
+template <typename T>
+static bool read_binary(std::istream& in, T& val) {
+    return (bool)in.read((char*)&val, sizeof(T));
+}
+
+// Poisson utility functions from Freebayes (when merging into vg
+// these should get offloaded into utility.cpp or something
+static long double gammaln(
+    long double x
+    ) {
+
+    long double cofactors[] = { 76.18009173, 
+                                -86.50532033,
+                                24.01409822,
+                                -1.231739516,
+                                0.120858003E-2,
+                                -0.536382E-5 };    
+
+    long double x1 = x - 1.0;
+    long double tmp = x1 + 5.5;
+    tmp -= (x1 + 0.5) * log(tmp);
+    long double ser = 1.0;
+    for (int j=0; j<=5; j++) {
+        x1 += 1.0;
+        ser += cofactors[j]/x1;
+    }
+    long double y =  (-1.0 * tmp + log(2.50662827465 * ser));
+
+    return y;
+}
+
+static long double factorial(
+    int n
+    ) {
+    if (n < 0) {
+        return (long double)0.0;
+    }
+    else if (n == 0) {
+        return (long double)1.0;
+    }
+    else {
+        return exp(gammaln(n + 1.0));
+    }
+}
+
+static long double poissonp(int observed, int expected) {
+    return (double) pow((double) expected, (double) observed) * (double) pow(M_E, (double) -expected) / factorial(observed);
+}
+
+
+/**
+ * Holds a DNA sequence packed 2 bits per base, with runs of anything that isn't
+ * A, C, G or T remembered separately (and given back as N). Must be built by
+ * appending bases in order, which is how we trace the reference anyway.
+ */
+class PackedSequence {
+public:
+    /**
+     * Make room for the given number of bases.
+     */
+    void reserve(size_t bases) {
+        words.reserve((bases + BASES_PER_WORD - 1) / BASES_PER_WORD);
+    }
+    
+    /**
+     * Add a base to the end of the sequence. Anything other than A, C, G or T
+     * will be stored as N.
+     */
+    void push_back(char base) {
+        if(length % BASES_PER_WORD == 0) {
+            // Start a new word
+            words.push_back(0);
+        }
+        
+        uint64_t code;
+        switch(base) {
+        case 'A':
+            code = 0;
+            break;
+        case 'C':
+            code = 1;
+            break;
+        case 'G':
+            code = 2;
+            break;
+        case 'T':
+            code = 3;
+            break;
+        default:
+            // Store a placeholder base and remember that this is really an N.
+            code = 0;
+            if(!nRuns.empty() && nRuns.back().second == length) {
+                // Extend the run we are in
+                nRuns.back().second++;
+            } else {
+                // Start a new run
+                nRuns.emplace_back(length, length + 1);
+            }
+        }
+        
+        words.back() |= code << (2 * (length % BASES_PER_WORD));
+        length++;
+    }
+    
+    /**
+     * Get the number of bases stored.
+     */
+    size_t size() const {
+        return length;
+    }
+    
+    /**
+     * Get the base at the given position.
+     */
+    char at(size_t pos) const {
+        if(pos >= length) {
+            throw std::out_of_range("Position " + std::to_string(pos) +
+                " past end of " + std::to_string(length) + " bp packed sequence");
+        }
+        return substr(pos, 1)[0];
+    }
+    
+    /**
+     * Extract the given range of bases as a string, like std::string::substr.
+     */
+    std::string substr(size_t start, size_t count = std::string::npos) const {
+        if(start > length) {
+            throw std::out_of_range("Substring start " + std::to_string(start) +
+                " past end of " + std::to_string(length) + " bp packed sequence");
+        }
+        count = std::min(count, length - start);
+        
+        std::string result(count, 'N');
+        
+        // Unpack a word at a time
+        size_t pos = start;
+        size_t filled = 0;
+        while(filled < count) {
+            size_t inWord = std::min(BASES_PER_WORD - pos % BASES_PER_WORD, count - filled);
+            uint64_t word = words[pos / BASES_PER_WORD] >> (2 * (pos % BASES_PER_WORD));
+            for(size_t i = 0; i < inWord; i++) {
+                result[filled++] = "ACGT"[word & 3];
+                word >>= 2;
+            }
+            pos += inWord;
+        }
+        
+        // Paint back in any Ns that overlap the range. Find the first run that
+        // ends after our start.
+        auto run = std::lower_bound(nRuns.begin(), nRuns.end(), start,
+            [](const std::pair<size_t, size_t>& r, size_t s) {
+            return r.second <= s;
+        });
+        for(; run != nRuns.end() && run->first < start + count; ++run) {
+            size_t from = std::max(run->first, start);
+            size_t to = std::min(run->second, start + count);
+            std::fill(result.begin() + (from - start), result.begin() + (to - start), 'N');
+        }
+        
+        return result;
+    }
+    
+    /**
+     * Write the packed sequence to a binary stream.
+     */
+    void serialize(std::ostream& out) const {
+        write_binary(out, (uint64_t)length);
+        write_binary(out, (uint64_t)nRuns.size());
+        for(auto& run : nRuns) {
+            write_binary(out, (uint64_t)run.first);
+            write_binary(out, (uint64_t)run.second);
+        }
+        out.write((const char*)words.data(), words.size() * sizeof(uint64_t));
+    }
+    
+    /**
+     * Replace this packed sequence with one read from a binary stream. Returns
+     * false if the stream didn't have a whole sequence in it.
+     */
+    bool load(std::istream& in) {
+        uint64_t newLength;
+        uint64_t runCount;
+        if(!read_binary(in, newLength) || !read_binary(in, runCount)) {
+            return false;
+        }
+        length = newLength;
+        
+        nRuns.resize(runCount);
+        for(auto& run : nRuns) {
+            uint64_t runStart;
+            uint64_t runEnd;
+            if(!read_binary(in, runStart) || !read_binary(in, runEnd)) {
+                return false;
+            }
+            run = std::make_pair(runStart, runEnd);
+        }
+        
+        words.resize((length + BASES_PER_WORD - 1) / BASES_PER_WORD);
+        return (bool)in.read((char*)words.data(), words.size() * sizeof(uint64_t));
+    }
+    
+private:
+    // How many 2-bit bases fit in a word
+    const static size_t BASES_PER_WORD = 32;
+    
+    // The packed bases, first base in the low bits of each word.
+    std::vector<uint64_t> words;
+    
+    // Sorted, non-overlapping [start, past-end) runs of N bases.
+    std::vector<std::pair<size_t, size_t>> nRuns;
+    
+    // Number of bases stored
+    size_t length = 0;
+};
+
+const size_t PackedSequence::BASES_PER_WORD;
+
+/**
+ * Holds indexes of the reference: position to node, node to position and
+ * orientation, and the full reference string.
+ */
+struct ReferenceIndex {
+    // Index from node ID to first position on the reference string and
+    // orientation it occurs there.
+    std::map<int64_t, std::pair<size_t, bool>> byId;
+    
+    // Index from start position on the reference to the oriented node that
+    // begins there.  Some nodes may be backward (orientation true) at their
+    // canonical reference positions. In this case, the last base of the node
+    // occurs at the given position.
+    std::map<size_t, vg::NodeTraversal> byStart;
+    
+    // The actual sequence of the reference. Empty if the reference is packed.
+    std::string sequence;
+    
+    // The sequence of the reference, 2 bits per base, if we were asked to save
+    // memory.
+    PackedSequence packed;
+    
+    // Are we using the packed sequence instead of the plain one?
+    bool isPacked = false;
+    
+    /**
+     * Get the length of the reference sequence.
+     */
+    size_t size() const {
+        return isPacked ? packed.size() : sequence.size();
+    }
+    
+    /**
+     * Get the reference base at the given position.
+     */
+    char at(size_t pos) const {
+        return isPacked ? packed.at(pos) : sequence.at(pos);
+    }
+    
+    /**
+     * Extract a range of the reference sequence as a string.
+     */
+    std::string substr(size_t start, size_t count = std::string::npos) const {
+        return isPacked ? packed.substr(start, count) : sequence.substr(start, count);
+    }
+};
+
+
+/**
+ * Make a letter into a full string because apparently that's too fancy for the
+ * standard library.
+ */
+static std::string char_to_string(const char& letter) {
+    std::string toReturn;
+    toReturn.push_back(letter);
+    return toReturn;
+}
+
+/**
+ * Write a minimal VCF header for a file with the given samples. If
+ * symbolicAlleles is set, also declare the symbolic alleles and INFO fields
+ * used for large deletions and insertions. If referenceBlocks is set, declare
+ * the fields used by gVCF reference blocks.
+ */
+static void write_vcf_header(std::ostream& stream, const std::vector<std::string>& sample_names, std::string& contig_name,
+    size_t contig_size, bool symbolicAlleles = false, bool referenceBlocks = false) {
+    stream << "##fileformat=VCFv4.2" << std::endl;
+    stream << "##ALT=<ID=NON_REF,Description=\"Represents any possible alternative allele at this location\">" << std::endl;
+    if(symbolicAlleles) {
+        stream << "##ALT=<ID=DEL,Description=\"Deletion relative to the reference\">" << std::endl;
+        stream << "##ALT=<ID=INS,Description=\"Insertion of novel sequence relative to the reference\">" << std::endl;
+    }
+    stream << "##INFO=<ID=XREF,Number=0,Type=Flag,Description=\"Present in original graph\">" << std::endl;
+    stream << "##INFO=<ID=XSEE,Number=.,Type=String,Description=\"Original graph node:offset cross-references\">" << std::endl;
+    stream << "##INFO=<ID=DP,Number=1,Type=Integer,Description=\"Total Depth\">" << std::endl;
+    if(symbolicAlleles || referenceBlocks) {
+        stream << "##INFO=<ID=END,Number=1,Type=Integer,Description=\"End position of the variant described in this record\">" << std::endl;
+    }
+    if(symbolicAlleles) {
+        stream << "##INFO=<ID=SVLEN,Number=.,Type=Integer,Description=\"Difference in length between REF and ALT alleles\">" << std::endl;
+        stream << "##INFO=<ID=SVTYPE,Number=1,Type=String,Description=\"Type of structural variant\">" << std::endl;
+    }
+    stream << "##FORMAT=<ID=DP,Number=1,Type=Integer,Description=\"Read Depth\">" << std::endl;
+    stream << "##FORMAT=<ID=GT,Number=1,Type=String,Description=\"Genotype\">" << std::endl;
+    stream << "##FORMAT=<ID=AD,Number=.,Type=Integer,Description=\"Allelic depths for the ref and alt alleles in the order listed\">" << std::endl;
+    stream << "##FORMAT=<ID=SB,Number=4,Type=Integer,Description=\"Forward and reverse support for ref and alt alleles.\">" << std::endl;
+    // We need this field to stratify on for VCF comparison. The info is in SB but vcfeval can't pull it out
+    stream << "##FORMAT=<ID=XAAD,Number=1,Type=Integer,Description=\"Alt allele read count.\">" << std::endl;
+    stream << "##FORMAT=<ID=AL,Number=.,Type=Float,Description=\"Allelic likelihoods for the ref and alt alleles in the order listed\">" << std::endl;
+    if(referenceBlocks) {
+        stream << "##FORMAT=<ID=MIN_DP,Number=1,Type=Integer,Description=\"Minimum DP observed within the reference block\">" << std::endl;
+    }
+    
+    if(!contig_name.empty()) {
+        // Announce the contig as well.
+        stream << "##contig=<ID=" << contig_name << ",length=" << contig_size << ">" << std::endl;
+    }
+    stream << "#CHROM\tPOS\tID\tREF\tALT\tQUAL\tFILTER\tINFO\tFORMAT";
+    for(auto& sample_name : sample_names) {
+        stream << "\t" << sample_name;
+    }
+    stream << std::endl;
+}
+
+
+
+/**
+ * Create the reference allele for a call. Must be called before any alt
+ * alleles are added.
+ */
+static void create_ref_allele(SiteCall& call, const std::string& allele) {
+    // Set the ref allele
+    call.ref = allele;
+    
+    for(size_t i = 0; i < call.ref.size(); i++) {
+        // Look at all the bases
+        if(call.ref[i] != 'A' && call.ref[i] != 'C' && call.ref[i] != 'G' && call.ref[i] != 'T') {
+            // Correct anything bogus (like "X") to N
+            call.ref[i] = 'N';
+        }
+    }
+    
+    // Make it 0 in the alleles-by-index list
+    call.alleles.push_back(allele);
+}
+
+/**
+ * Add a new alt allele to a call.
+ *
+ * If that allele already exists in the call, does not add it again.
+ *
+ * Retuerns the allele number (0, 1, 2, etc.) corresponding to the given allele
+ * string in the given call. 
+ */
+static int add_alt_allele(SiteCall& call, const std::string& allele) {
+    // Copy the allele so we can throw out bad characters
+    std::string fixed(allele);
+    
+    for(size_t i = 0; i < fixed.size(); i++) {
+        // Look at all the bases
+        if(fixed[i] != 'A' && fixed[i] != 'C' && fixed[i] != 'G' && fixed[i] != 'T') {
+            // Correct anything bogus (like "X") to N
+            fixed[i] = 'N';
+        }
+    }
+    
+    for(int i = 0; i < call.alleles.size(); i++) {
+        if(call.alleles[i] == fixed) {
+            // Already exists
+            return i;
+        }
+    }
+
+    // Add it as an alt
+    call.alt.push_back(fixed);
+    // Make it next in the alleles-by-index list
+    call.alleles.push_back(fixed);
+
+    // We added it in at the end
+    return call.alleles.size() - 1;
+}
+
+/**
+ * Add a symbolic alt allele (like <DEL> or <INS>) of the given type to a call,
+ * standing in for a change in length of svLength bases that ends at the given
+ * 1-based reference position. The ref allele should be just the padding base
+ * before the event.
+ *
+ * Returns the allele number of the new allele.
+ */
+static int add_symbolic_allele(SiteCall& call, const std::string& svType, int64_t end, int64_t svLength) {
+    call.svType = svType;
+    call.end = end;
+    call.svLength = svLength;
+    
+    std::string allele = "<" + svType + ">";
+    call.alt.push_back(allele);
+    call.alleles.push_back(allele);
+    return call.alleles.size() - 1;
+}
+
+/**
+ * Normalize a call's alleles the way bcftools norm would. Bases shared by all
+ * the alleles are trimmed off the right, and whenever that empties an allele,
+ * the call is moved one base left along the reference and the base before it
+ * is put back on the front of every allele. Then bases shared by all the
+ * alleles are trimmed off the left, leaving at least one base in each. Indels
+ * end up left-aligned with one anchoring base. Calls with symbolic alleles
+ * are left alone. Genotypes still refer to the same alleles afterwards.
+ */
+static void normalize_call(SiteCall& call, const ReferenceIndex& index, int64_t variantOffset) {
+    if(!call.svType.empty() || call.referenceBlock || call.alt.empty()) {
+        return;
+    }
+    
+    // Work on the ref and alts together, ref first.
+    std::vector<std::string> alleles(1, call.ref);
+    alleles.insert(alleles.end(), call.alt.begin(), call.alt.end());
+    // Where does the first base of the alleles fall on the reference?
+    int64_t start = call.position - 1 - variantOffset;
+    bool changed = false;
+    
+    bool shifting = true;
+    while(shifting) {
+        shifting = false;
+        
+        // Can we trim a base off the right? Not if that would leave us with an
+        // empty allele that we can't fill back in from the left.
+        bool sharedLast = true;
+        for(auto& allele : alleles) {
+            if(allele.empty() || allele.back() != alleles.front().back() || (allele.size() == 1 && start == 0)) {
+                sharedLast = false;
+                break;
+            }
+        }
+        if(!sharedLast) {
+            break;
+        }
+        
+        bool emptied = false;
+        for(auto& allele : alleles) {
+            allele.pop_back();
+            emptied = emptied || allele.empty();
+        }
+        changed = true;
+        
+        if(emptied) {
+            // Move left to pick up the reference base before, cleaned up the
+            // same way the ref allele is.
+            start--;
+            char base = index.at(start);
+            if(base != 'A' && base != 'C' && base != 'G' && base != 'T') {
+                base = 'N';
+            }
+            for(auto& allele : alleles) {
+                allele.insert(allele.begin(), base);
+            }
+        }
+        shifting = true;
+    }
+    
+    while(true) {
+        // Trim bases shared by all the alleles off the left
+        bool sharedFirst = true;
+        for(auto& allele : alleles) {
+            if(allele.size() < 2 || allele.front() != alleles.front().front()) {
+                sharedFirst = false;
+                break;
+            }
+        }
+        if(!sharedFirst) {
+            break;
+        }
+        for(auto& allele : alleles) {
+            allele.erase(allele.begin());
+        }
+        start++;
+        changed = true;
+    }
+    
+    if(changed) {
+        call.position = start + 1 + variantOffset;
+        call.ref = alleles.front();
+        call.alt.assign(alleles.begin() + 1, alleles.end());
+        call.alleles = alleles;
+    }
+}
+
+/**
+ * Return true if a call may be output, or false if this call is valid but
+ * the GATK might choke on it.
+ *
+ * Mostly used to throw out variants with very long alleles, because GATK has an
+ * allele length limit. How alleles that really *are* 1 megabase deletions are
+ * to be specified to GATK is left as an exercise to the reader.
+ */
+static bool can_write_alleles(const SiteCall& call) {
+    for(auto& allele : call.alleles) {
+        if(MAX_ALLELE_LENGTH > 0 && allele.size() > MAX_ALLELE_LENGTH) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Compute a quick quality for a sample's call: combine likelihood and depth,
+ * using a poisson for the latter, against the given expected support for the
+ * region.
+ */
+static double call_quality(const SampleCall& call, const Support& baselineSupport) {
+    // todo: revize which depth (cur: avg) / likelihood (cur: min) pair to use
+    double genLikelihood;
+    if (call.has_genotype(0, 0)) {
+        genLikelihood = log10(poissonp(total(call.refSupport), total(baselineSupport)));
+        genLikelihood += call.refLikelihood;
+    } else if (call.has_genotype(1, 1)) {
+        genLikelihood = log10(poissonp(total(call.altSupport), total(baselineSupport)));
+        genLikelihood += call.altLikelihood;
+    } else {
+        genLikelihood = log10(poissonp(total(call.refSupport), 0.5 * total(baselineSupport))) +
+            log10(poissonp(total(call.altSupport), 0.5 * total(baselineSupport)));
+        genLikelihood += call.refLikelihood + call.altLikelihood;
+    }
+    return -10. * log10(1. - exp10(genLikelihood));
+}
+
+/**
+ * Turn a call into a vcflib Variant in the given VCF file, on the given contig,
+ * for the given samples, which must be in the same order as the call's.
+ */
+vcflib::Variant to_variant(const SiteCall& call, vcflib::VariantCallFile& vcf,
+    const std::string& contigName, const std::vector<std::string>& sampleNames) {
+    
+    vcflib::Variant variant;
+    variant.sequenceName = contigName;
+    variant.setVariantCallFile(vcf);
+    variant.quality = call.quality;
+    variant.position = call.position;
+    variant.id = call.id;
+    
+    if(call.known) {
+        // Flag the variant as reference. Don't put in a false entry if it
+        // isn't, because vcflib will spit out the flag anyway...
+        variant.infoFlags["XREF"] = true;
+    }
+    
+    for(auto& crossreference : call.crossreferences) {
+        variant.info["XSEE"].push_back(std::to_string(crossreference.first) + ":" +
+            std::to_string(crossreference.second));
+    }
+    
+    if(!call.svType.empty()) {
+        // Describe the symbolic allele
+        variant.info["SVTYPE"].push_back(call.svType);
+        variant.info["END"].push_back(std::to_string(call.end));
+        variant.info["SVLEN"].push_back(std::to_string(call.svLength));
+    }
+    
+    variant.ref = call.ref;
+    variant.alt = call.alt;
+    variant.alleles = call.alleles;
+    // Build the reciprocal index-by-allele mapping
+    variant.updateAlleleIndexes();
+    
+    // The variant depth is the total over the samples
+    variant.info["DP"].push_back(std::to_string(call.depth()));
+    
+    if(call.referenceBlock) {
+        // Reference blocks just say how far they go and how deep they are.
+        variant.info["END"].push_back(std::to_string(call.end));
+        variant.format.push_back("GT");
+        variant.format.push_back("DP");
+        variant.format.push_back("MIN_DP");
+        for(size_t i = 0; i < call.samples.size(); i++) {
+            auto& sample = call.samples[i];
+            auto& fields = variant.samples[sampleNames.at(i)];
+            fields["GT"].push_back(sample.genotype_string());
+            fields["DP"].push_back(std::to_string(sample.depth()));
+            fields["MIN_DP"].push_back(std::to_string(sample.minDepth));
+        }
+        return variant;
+    }
+    
+    // Say what we're going to spit out for each sample: genotype, depth,
+    // allelic depths, strand biases, total alt allele depth, and allelic
+    // likelihoods (from minimum values found on their paths).
+    variant.format.push_back("GT");
+    variant.format.push_back("DP");
+    variant.format.push_back("AD");
+    variant.format.push_back("SB");
+    variant.format.push_back("XAAD");
+    variant.format.push_back("AL");
+    
+    for(size_t i = 0; i < call.samples.size(); i++) {
+        auto& sample = call.samples[i];
+        auto& fields = variant.samples[sampleNames.at(i)];
+        
+        fields["GT"].push_back(sample.genotype_string());
+        fields["DP"].push_back(std::to_string(sample.depth()));
+        
+        fields["AD"].push_back(std::to_string((int64_t)round(total(sample.refSupport))));
+        fields["AD"].push_back(std::to_string((int64_t)round(total(sample.altSupport))));
+        for(size_t allele = 2; allele < call.alleles.size(); allele++) {
+            // Nothing supports the gVCF <NON_REF> allele.
+            fields["AD"].push_back("0");
+        }
+        
+        fields["SB"].push_back(std::to_string((int64_t)round(sample.refSupport.first)));
+        fields["SB"].push_back(std::to_string((int64_t)round(sample.refSupport.second)));
+        fields["SB"].push_back(std::to_string((int64_t)round(sample.altSupport.first)));
+        fields["SB"].push_back(std::to_string((int64_t)round(sample.altSupport.second)));
+        
+        fields["XAAD"].push_back(std::to_string((int64_t)round(total(sample.altSupport))));
+        
+        fields["AL"].push_back(to_string_ss(sample.refLikelihood));
+        fields["AL"].push_back(to_string_ss(sample.altLikelihood));
+    }
+    
+    return variant;
+}
+
+/**
+ * Return true if a mapping is a perfect match, and false if it isn't.
+ */
+static bool mapping_is_perfect_match(const vg::Mapping& mapping) {
+    for (auto edit : mapping.edit()) {
+        if (edit.from_length() != edit.to_length() || !edit.sequence().empty()) {
+            // This edit isn't a perfect match
+            return false;
+        }
+    }
+    
+    // If we get here, all the edits are perfect matches.
+    // Note that Mappings with no edits at all are full-length perfect matches.
+    return true;
+}
+
+/**
+ * A read-only snapshot of the graph's connectivity, for bubble searching. Each
+ * oriented node gets a dense integer handle, and the oriented nodes that can
+ * come before it are stored in one flat compressed-sparse-row array, so a
+ * search step just walks a contiguous range instead of asking vg for
+ * neighbors.
+ *
+ * If read support is provided, nodes with no support are left out of all the
+ * predecessor lists, so searches never step onto them.
+ */
+class NodeAdjacency {
+public:
+    // A handle is a node's dense rank times 2, plus 1 if it is backward.
+    typedef uint64_t Handle;
+    
+    /**
+     * Snapshot the given graph, remembering which nodes are on the given
+     * reference path. If nodeReadSupport is not empty, leave out nodes that
+     * have no support in it.
+     */
+    NodeAdjacency(vg::VG& graph, const ReferenceIndex& index,
+        const std::map<vg::Node*, Support>& nodeReadSupport = std::map<vg::Node*, Support>()) {
+        
+        // Which ranks can we step onto?
+        std::vector<uint8_t> supported;
+        
+        graph.for_each_node([&](vg::Node* node) {
+            // Give every node a rank
+            rankById[node->id()] = nodes.size();
+            nodes.push_back(node);
+            lengths.push_back(node->sequence().size());
+            auto placement = index.byId.find(node->id());
+            referenceStarts.push_back(placement == index.byId.end() ? NOT_ON_REFERENCE : placement->second.first);
+            
+            // Work out support once here, instead of on every search step.
+            auto found = nodeReadSupport.find(node);
+            supported.push_back(nodeReadSupport.empty() ||
+                (found != nodeReadSupport.end() && total(found->second) != 0));
+        });
+        
+        // Now fill in the predecessors of every handle in order.
+        offsets.reserve(nodes.size() * 2 + 1);
+        offsets.push_back(0);
+        std::vector<vg::NodeTraversal> prevNodes;
+        for(Handle here = 0; here < nodes.size() * 2; here++) {
+            prevNodes.clear();
+            graph.nodes_prev(traversal(here), prevNodes);
+            for(auto& prevNode : prevNodes) {
+                Handle prev = handle(prevNode);
+                if(supported[prev >> 1]) {
+                    predecessors.push_back(prev);
+                }
+            }
+            offsets.push_back(predecessors.size());
+        }
+    }
+    
+    /**
+     * Get the handle for an oriented node.
+     */
+    Handle handle(const vg::NodeTraversal& traversal) const {
+        return (rankById.at(traversal.node->id()) << 1) | (Handle)traversal.backward;
+    }
+    
+    /**
+     * Get the oriented node for a handle.
+     */
+    vg::NodeTraversal traversal(Handle handle) const {
+        return vg::NodeTraversal(nodes[handle >> 1], handle & 1);
+    }
+    
+    /**
+     * Get the handle for the other orientation of the same node.
+     */
+    static Handle flip(Handle handle) {
+        return handle ^ 1;
+    }
+    
+    /**
+     * Get the dense rank of a handle's node, which is less than node_count().
+     */
+    static size_t rank(Handle handle) {
+        return handle >> 1;
+    }
+    
+    /**
+     * Get the number of nodes in the snapshot.
+     */
+    size_t node_count() const {
+        return nodes.size();
+    }
+    
+    /**
+     * Get the node for a handle.
+     */
+    vg::Node* node(Handle handle) const {
+        return nodes[handle >> 1];
+    }
+    
+    /**
+     * Get the length in bases of a handle's node.
+     */
+    size_t length(Handle handle) const {
+        return lengths[handle >> 1];
+    }
+    
+    /**
+     * Return true if a handle's node is on the reference path.
+     */
+    bool on_reference(Handle handle) const {
+        return referenceStarts[handle >> 1] != NOT_ON_REFERENCE;
+    }
+    
+    /**
+     * Get the first reference position of a handle's node, if it is on the
+     * reference path.
+     */
+    size_t reference_start(Handle handle) const {
+        return referenceStarts[handle >> 1];
+    }
+    
+    /**
+     * Get the number of handles, which are numbered from 0.
+     */
+    size_t handle_count() const {
+        return nodes.size() * 2;
+    }
+    
+    /**
+     * Get the start of the range of handles that can come before the given
+     * handle.
+     */
+    const Handle* prev_begin(Handle handle) const {
+        return predecessors.data() + offsets[handle];
+    }
+    
+    /**
+     * Get the end of the range of handles that can come before the given
+     * handle.
+     */
+    const Handle* prev_end(Handle handle) const {
+        return predecessors.data() + offsets[handle + 1];
+    }
+    
+private:
+    // Node for each rank
+    std::vector<vg::Node*> nodes;
+    // Sequence length for each rank
+    std::vector<size_t> lengths;
+    // Where each rank first starts on the reference, if it is on it at all
+    const static size_t NOT_ON_REFERENCE = (size_t)-1;
+    std::vector<size_t> referenceStarts;
+    // Where each handle's predecessors start in predecessors, plus a final
+    // past-the-end entry.
+    std::vector<uint64_t> offsets;
+    // All the predecessor lists, one after the other
+    std::vector<Handle> predecessors;
+    // Rank for each node ID
+    std::unordered_map<int64_t, Handle> rankById;
+};
+
+const size_t NodeAdjacency::NOT_ON_REFERENCE;
+
+/**
+ * Flip a NodeTraversal around and return the flipped copy.
+ */
+static vg::NodeTraversal flip(vg::NodeTraversal toFlip) {
+    return vg::NodeTraversal(toFlip.node, !toFlip.backward);
+}
+
+
+/**
+ * Enumerates paths from a node out to the reference path in one direction,
+ * shortest (in bases) first, one at a time. Paths are only explored as far as
+ * is needed to produce the next one, so a caller that finds what it wants
+ * early never pays for the rest of the search.
+ *
+ * Paths come out as handles in the same order a std::set of (length, path)
+ * pairs of NodeTraversals would hold them, and always run left to right, starting (when searching left) or
+ * ending (when searching right) with the node the search started from. Will
+ * not visit nodes that were pruned from the graph snapshot for having no
+ * support.
+ *
+ * If given a budget, stops producing paths once it is spent.
+ */
+class BubblePathSearch {
+public:
+    /**
+     * Prepare to search left, or right, from the given node, extending paths
+     * up to the given number of nodes deep, and optionally charging the work
+     * to the given budget.
+     */
+    BubblePathSearch(const NodeAdjacency& graph, vg::NodeTraversal node, bool searchRight,
+        int64_t maxDepth = 10, SearchBudget* budget = nullptr) : graph(graph),
+        searchRight(searchRight), maxDepth(maxDepth), budget(budget) {
+        
+        // Searching right is searching left from the backward version of the
+        // node.
+        NodeAdjacency::Handle start = graph.handle(searchRight ? flip(node) : node);
+        steps.push_back(SearchStep {start, -1, 1, graph.length(start)});
+        frontier.push(std::make_pair(graph.length(start), 0));
+    }
+    
+    /**
+     * Get the next shortest path to the reference. Returns false if there are
+     * no more.
+     */
+    bool next(std::vector<NodeAdjacency::Handle>& path) {
+        while(readyNext == ready.size()) {
+            // We need to find some more complete paths.
+            if(frontier.empty()) {
+                // We've searched everywhere.
+                return false;
+            }
+            
+            // Since extending a path never makes it shorter, once we take a
+            // partial path of some length off the frontier, every complete path
+            // of that length will be found before anything longer comes off.
+            // Collect them all so we can put them in order.
+            ready.clear();
+            readyNext = 0;
+            size_t groupLength = frontier.top().first;
+            while(!frontier.empty() && frontier.top().first == groupLength) {
+                if(budget != nullptr && !budget->spend()) {
+                    // We've done all the work we're allowed to. We can't hand
+                    // out a partial group, since it might be out of order.
+                    return false;
+                }
+                size_t stepIndex = frontier.top().second;
+                frontier.pop();
+                expand(stepIndex);
+            }
+            
+            // Order ties the same way a set of paths of NodeTraversals would.
+            auto traversalLess = [&](NodeAdjacency::Handle a, NodeAdjacency::Handle b) {
+                return graph.traversal(a) < graph.traversal(b);
+            };
+            std::sort(ready.begin(), ready.end(), [&](const std::vector<NodeAdjacency::Handle>& a,
+                const std::vector<NodeAdjacency::Handle>& b) {
+                return std::lexicographical_compare(a.begin(), a.end(), b.begin(), b.end(), traversalLess);
+            });
+            ready.erase(std::unique(ready.begin(), ready.end()), ready.end());
+        }
+        
+        path = std::move(ready[readyNext++]);
+        return true;
+    }
+    
+private:
+    /**
+     * Either finish the path ending at the given step, if it reached the
+     * reference, or extend it by one more node in every possible way.
+     */
+    void expand(size_t stepIndex) {
+        // Copy the step, since steps may move as we add to it.
+        SearchStep step = steps[stepIndex];
+        
+        // We can't just throw out longer paths, because shorter paths may need
+        // to visit a node twice (in opposite orientations) and thus might get
+        // rejected later. Or they might overlap with paths on the other side.
+        
+        if(graph.on_reference(step.handle)) {
+            // This node is on the reference path. TODO: we don't care if it
+            // lands in a place that is itself deleted.
+            
+            if(budget != nullptr) {
+                budget->touch(graph.reference_start(step.handle), graph.length(step.handle));
+            }
+            
+            // Trace the path back from here to the start, which puts it in
+            // left to right order for a leftward search.
+            std::vector<NodeAdjacency::Handle> path;
+            for(int64_t i = stepIndex; i != -1; i = steps[i].parent) {
+                path.push_back(steps[i].handle);
+            }
+            
+            if(searchRight) {
+                // Flip the path to run the other way
+                std::reverse(path.begin(), path.end());
+                for(auto& handle : path) {
+                    // And invert the orientation of every node in the path in place.
+                    handle = NodeAdjacency::flip(handle);
+                }
+            }
+            
+            ready.push_back(std::move(path));
+            
+            // Don't bother looking for extensions, we already got there.
+        } else if(step.depth <= maxDepth) {
+            // We haven't hit the reference path yet, but we also haven't hit
+            // the max depth. Extend with all the possible extensions.
+            for(auto prev = graph.prev_begin(step.handle); prev != graph.prev_end(step.handle); ++prev) {
+                size_t length = step.length + graph.length(*prev);
+                frontier.push(std::make_pair(length, steps.size()));
+                steps.push_back(SearchStep {*prev, (int64_t)stepIndex, step.depth + 1, length});
+            }
+        }
+    }
+
+    // Each step in the search extends the path to an earlier step by one
+    // oriented node. Rather than copying paths around, we keep every step in
+    // one array with a link back to the step it extends.
+    struct SearchStep {
+        NodeAdjacency::Handle handle;
+        // Index of the step this one extends, or -1 for the start
+        int64_t parent;
+        // Number of nodes on the path ending here
+        int64_t depth;
+        // Number of bases on the path ending here
+        size_t length;
+    };
+    
+    const NodeAdjacency& graph;
+    bool searchRight;
+    int64_t maxDepth;
+    SearchBudget* budget;
+    
+    // All the steps taken so far
+    std::vector<SearchStep> steps;
+    
+    // Steps not yet finished or extended, as (length, step index), shortest on
+    // top.
+    std::priority_queue<std::pair<size_t, size_t>, std::vector<std::pair<size_t, size_t>>,
+        std::greater<std::pair<size_t, size_t>>> frontier;
+        
+    // Complete paths of the current length, in order, and the next one to hand
+    // out.
+    std::vector<std::vector<NodeAdjacency::Handle>> ready;
+    size_t readyNext = 0;
+};
+
+/**
+ * Given a snapshot of a vg graph, a node in the graph, and an index for the reference path,
+ * look out from the node in both directions to find a shortest bubble relative
+ * to the path, with a consistent orientation. The bubble may not visit the same
+ * node twice.
+ *
+ * Takes a max depth for the searches producing the paths on each side.
+ *
+ * Paths on each side are generated lazily, shortest first, and we stop as soon
+ * as we find a valid combination. This gives the same answer as listing every
+ * path on each side and taking the first valid combination, with the left
+ * path varying slowest.
+ *
+ * If a budget is given, the search gives up and returns no bubble when the
+ * budget runs out; check the budget to tell that apart from there being no
+ * bubble.
+ * 
+ * Return the ordered and oriented nodes in the bubble, with the outer nodes
+ * being oriented forward along the named path, and with the first node coming
+ * before the last node in the reference.
+ */
+static std::vector<vg::NodeTraversal>
+find_bubble(const NodeAdjacency& graph, vg::Node* node, const ReferenceIndex& index,
+    int64_t maxDepth = 10, SearchBudget* budget = nullptr) {
+
+    // Find paths on both sides, with nodes on the primary path at the outsides
+    // and this node in the middle.
+    BubblePathSearch leftPaths(graph, vg::NodeTraversal(node), false, maxDepth, budget);
+    BubblePathSearch rightPaths(graph, vg::NodeTraversal(node), true, maxDepth, budget);
+    
+    // We have to try every right path we have found so far against each left
+    // path, so keep them around, along with where they land on the reference.
+    struct RightPath {
+        std::vector<NodeAdjacency::Handle> path;
+        std::pair<size_t, bool> refPos;
+        bool relativeOrientation;
+    };
+    std::vector<RightPath> rightList;
+    
+    // To check for overlap without building sets, we stamp the ranks of the
+    // nodes in the current left path with a number unique to that left path.
+    // The stamps are kept per thread and reused between searches.
+    static thread_local std::vector<uint32_t> leftPathStamps;
+    static thread_local uint32_t leftPathNumber = 0;
+    if(leftPathStamps.size() != graph.node_count()) {
+        leftPathStamps.assign(graph.node_count(), 0);
+        leftPathNumber = 0;
+    }
+    
+    // Find a combination of two paths which gets us to the reference in a
+    // consistent orientation (meaning that when you look at the ending nodes'
+    // Mappings in the reference path, the ones with minimal ranks have the same
+    // orientations) and which doesn't use the same nodes on both sides.
+    
+    std::vector<NodeAdjacency::Handle> leftPath;
+    while(leftPaths.next(leftPath)) {
+        // Figure out the relative orientation for the leftmost node.
+#ifdef debug        
+        std::cerr << "Left path: " << std::endl;
+        for(auto handle : leftPath ) {
+            std::cerr << "\t" << graph.traversal(handle) << std::endl;
+        }
+#endif    
+        // Split out its node and orientation
+        auto leftNode = graph.node(leftPath.front());
+        bool leftOrientation = leftPath.front() & 1;
+        
+        // Get where it falls in the reference as a position, orientation pair.
+        auto leftRefPos = index.byId.at(leftNode->id());
+        
+        // We have a backward orientation relative to the reference path if we
+        // were traversing the anchoring node backwards, xor if it is backwards
+        // in the reference path.
+        bool leftRelativeOrientation = leftOrientation != leftRefPos.second;
+        
+        // Mark all the nodes in the left path
+        leftPathNumber++;
+        if(leftPathNumber == 0) {
+            // We wrapped around, so old stamps could look current.
+            std::fill(leftPathStamps.begin(), leftPathStamps.end(), 0);
+            leftPathNumber = 1;
+        }
+        for(auto handle : leftPath) {
+            leftPathStamps[NodeAdjacency::rank(handle)] = leftPathNumber;
+        }
+        
+        for(size_t rightNumber = 0; ; rightNumber++) {
+            if(rightNumber == rightList.size()) {
+                // Go find another right path
+                RightPath found;
+                if(!rightPaths.next(found.path)) {
+                    // There are no more, so this left path can't be used.
+                    break;
+                }
+                
+                // Figure out the relative orientation for the rightmost node.
+#ifdef debug            
+                std::cerr << "Right path: " << std::endl;
+                for(auto handle : found.path ) {
+                    std::cerr << "\t" << graph.traversal(handle) << std::endl;
+                }
+#endif            
+                // Split out its node and orientation
+                // Remember it's at the end of this path.
+                auto rightNode = graph.node(found.path.back());
+                bool rightOrientation = found.path.back() & 1;
+                
+                // Get where it falls in the reference as a position, orientation pair.
+                found.refPos = index.byId.at(rightNode->id());
+                
+                // We have a backward orientation relative to the reference path if we
+                // were traversing the anchoring node backwards, xor if it is backwards
+                // in the reference path.
+                found.relativeOrientation = rightOrientation != found.refPos.second;
+                
+                rightList.push_back(std::move(found));
+            }
+            const auto& rightPath = rightList[rightNumber].path;
+            const auto& rightRefPos = rightList[rightNumber].refPos;
+            bool rightRelativeOrientation = rightList[rightNumber].relativeOrientation;
+            
+            if(leftRelativeOrientation == rightRelativeOrientation &&
+                ((!leftRelativeOrientation && leftRefPos.first < rightRefPos.first) ||
+                (leftRelativeOrientation && leftRefPos.first > rightRefPos.first))) {
+                // We found a pair of paths that get us to and from the
+                // reference without turning around, and that don't go back to
+                // the reference before they leave.
+                
+                // We need to detect overlap with the left path, for all but the
+                // first node on the right path (which is the shared middle
+                // node).
+                bool overlap = false;
+                for(size_t i = 1; i < rightPath.size(); i++) {
+                    if(leftPathStamps[NodeAdjacency::rank(rightPath[i])] == leftPathNumber) {
+                        // We already visited this node on the left side.
+                        overlap = true;
+                        break;
+                    }
+                }
+                
+                if(overlap) {
+                    // Can't combine this right with this left, as they share
+                    // nodes and we can't handle the copy number implications.
+                    // Try the next right.
+                    // TODO: handle the copy number implications.
+                    continue;
+                }
+                
+                // Start with the left path, and add all but the first node of
+                // the right path.
+                std::vector<vg::NodeTraversal> fullPath;
+                fullPath.reserve(leftPath.size() + rightPath.size() - 1);
+                for(auto handle : leftPath) {
+                    fullPath.push_back(graph.traversal(handle));
+                }
+                for(size_t i = 1; i < rightPath.size(); i++) {
+                    fullPath.push_back(graph.traversal(rightPath[i]));
+                }
+                
+                if(leftRelativeOrientation) {
+                    // Turns out our anchored path is backwards.
+                    
+                    // Reorder everything the other way
+                    std::reverse(fullPath.begin(), fullPath.end());
+                    
+                    for(auto& traversal : fullPath) {
+                        // Flip each traversal
+                        traversal = flip(traversal);
+                    }
+                }
+                
+                // Just give the first valid path we find.
+#ifdef debug        
+                std::cerr << "Merged path:" << std::endl;
+                for(auto traversal : fullPath) {
+                    std::cerr << "\t" << traversal << std::endl;
+                }
+#endif
+                return fullPath;
+            }
+            
+        }
+    }
+    
+    // Return the empty path if we can't find anything.
+    return std::vector<vg::NodeTraversal>();
+    
+}
+
+
+/**
+ * Complement table for reverse_complement_into. Matches the behavior of
+ * vg::reverse_complement: anything that isn't a base we know becomes N.
+ */
+struct ComplementTable {
+    char table[256];
+    
+    ComplementTable() {
+        for(size_t i = 0; i < 256; i++) {
+            table[i] = 'N';
+        }
+        table[(unsigned char)'A'] = 'T';
+        table[(unsigned char)'T'] = 'A';
+        table[(unsigned char)'C'] = 'G';
+        table[(unsigned char)'G'] = 'C';
+        table[(unsigned char)'a'] = 't';
+        table[(unsigned char)'t'] = 'a';
+        table[(unsigned char)'c'] = 'g';
+        table[(unsigned char)'g'] = 'c';
+        // Keep the GCSA2 start/stop characters paired up like vg does.
+        table[(unsigned char)'#'] = '$';
+        table[(unsigned char)'$'] = '#';
+    }
+    
+    /**
+     * Get the complement of a base.
+     */
+    char operator[](char base) const {
+        return table[(unsigned char)base];
+    }
+};
+
+// The one complement table everyone uses.
+const static ComplementTable COMPLEMENT;
+
+#ifdef __SSE2__
+/**
+ * Add the complements of one pair of bases, in a block of 16, into
+ * complemented, and mark where they were in known.
+ */
+static inline void complement_pair_16(__m128i bases, char first, char second, __m128i& complemented, __m128i& known) {
+    __m128i isFirst = _mm_cmpeq_epi8(bases, _mm_set1_epi8(first));
+    __m128i isSecond = _mm_cmpeq_epi8(bases, _mm_set1_epi8(second));
+    complemented = _mm_or_si128(complemented, _mm_and_si128(isFirst, _mm_set1_epi8(second)));
+    complemented = _mm_or_si128(complemented, _mm_and_si128(isSecond, _mm_set1_epi8(first)));
+    known = _mm_or_si128(known, _mm_or_si128(isFirst, isSecond));
+}
+
+/**
+ * Complement 16 bases at once, the same way as ComplementTable: each base we
+ * know is swapped for its partner, and anything else becomes N.
+ */
+static inline __m128i complement_16(__m128i bases) {
+    // The pairs are spelled out so the compiler can keep all the constants in
+    // registers.
+    __m128i complemented = _mm_setzero_si128();
+    __m128i known = _mm_setzero_si128();
+    complement_pair_16(bases, 'A', 'T', complemented, known);
+    complement_pair_16(bases, 'C', 'G', complemented, known);
+    complement_pair_16(bases, 'a', 't', complemented, known);
+    complement_pair_16(bases, 'c', 'g', complemented, known);
+    complement_pair_16(bases, '#', '$', complemented, known);
+    return _mm_or_si128(complemented, _mm_andnot_si128(known, _mm_set1_epi8('N')));
+}
+
+/**
+ * Reverse the order of the 16 bytes in a vector, with only SSE2 shuffles.
+ */
+static inline __m128i reverse_16(__m128i bytes) {
+    // Swap the bytes in each 16-bit word, then reverse the words.
+    bytes = _mm_or_si128(_mm_slli_epi16(bytes, 8), _mm_srli_epi16(bytes, 8));
+    bytes = _mm_shufflelo_epi16(bytes, _MM_SHUFFLE(0, 1, 2, 3));
+    bytes = _mm_shufflehi_epi16(bytes, _MM_SHUFFLE(0, 1, 2, 3));
+    return _mm_shuffle_epi32(bytes, _MM_SHUFFLE(1, 0, 3, 2));
+}
+#endif
+
+/**
+ * Write the reverse complement of the given number of bases starting at
+ * source into the buffer at dest, without allocating. The buffers must not
+ * overlap.
+ */
+static void reverse_complement_into(const char* source, size_t length, char* dest) {
+    // Walk the source backward and the destination forward.
+    const char* cursor = source + length;
+    size_t i = 0;
+#ifdef __SSE2__
+    // Do 16 bases at a time while we can. SSE2 is always there on x86-64.
+    for(; i + 16 <= length; i += 16) {
+        cursor -= 16;
+        __m128i bases = _mm_loadu_si128((const __m128i*)cursor);
+        _mm_storeu_si128((__m128i*)(dest + i), reverse_16(complement_16(bases)));
+    }
+#endif
+    // Then finish up (or do everything, without SSE2) with a simple table
+    // lookup loop with no branches, which the compiler can unroll.
+    for(; i < length; i++) {
+        dest[i] = COMPLEMENT[*(--cursor)];
+    }
+}
+
+/**
+ * Return true if the given character is one we accept as a reference base.
+ */
+static bool is_reference_base(char base) {
+    return base == 'A' || base == 'T' || base == 'C' || base == 'G' || base == 'N';
+}
+
+/**
+ * Trace out the reference path in the given graph named by the given name.
+ * Returns a structure with useful indexes of the reference.
+ *
+ * The reference sequence is built in two passes: the first sums up the node
+ * lengths so we can allocate the sequence exactly once, and the second writes
+ * each node's bases (reverse complemented if necessary) directly into place.
+ *
+ * If packSequence is set, the reference sequence is stored 2 bits per base in
+ * the index's packed sequence instead.
+ */
+static ReferenceIndex trace_reference_path(vg::VG& vg, std::string refPathName,
+    bool packSequence = false) {
+    // Make sure the reference path is present
+    assert(vg.paths.has_path(refPathName));
+    
+    // We'll fill this in and then return it.
+    ReferenceIndex index;
+    
+    const auto& refPath = vg.paths.get_path(refPathName);
+    
+    // First pass: work out how long the reference is going to be, so we only
+    // ever have one copy of it in memory.
+    size_t referenceLength = 0;
+    for(const auto& mapping : refPath) {
+        referenceLength += vg.get_node(mapping.position().node_id())->sequence().size();
+    }
+    // This may be a few bytes more than we need if we drop leading bogus
+    // characters below, but that's fine.
+    index.isPacked = packSequence;
+    if(packSequence) {
+        index.packed.reserve(referenceLength);
+    } else {
+        index.sequence.resize(referenceLength);
+    }
+    
+    // What base are we at in the reference
+    size_t referenceBase = 0;
+    
+    // What was the last rank? Ranks must always go up.
+    int64_t lastRank = -1;
+    
+    // Second pass: build the indexes and fill in the sequence.
+    for(const auto& mapping : refPath) {
+        // All the mappings need to be perfect matches.
+        assert(mapping_is_perfect_match(mapping));
+        
+        // Find the node
+        vg::Node* node = vg.get_node(mapping.position().node_id());
+    
+        if(!index.byId.count(node->id())) {
+            // This is the first time we have visited this node in the reference
+            // path.
+            
+            // Add in a mapping.
+            index.byId[node->id()] = 
+                std::make_pair(referenceBase, mapping.position().is_reverse());
+#ifdef debug
+            std::cerr << "Node " << node->id() << " rank " << mapping.rank()
+                << " starts at base " << referenceBase << " with "
+                << node->sequence() << std::endl;
+#endif
+            
+            // Make sure ranks are monotonically increasing along the path.
+            assert(mapping.rank() > lastRank);
+            lastRank = mapping.rank();
+        }
+        
+        // Look at the node's sequence in place, without copying it.
+        const std::string& sequence = node->sequence();
+        
+        // How many leading characters of it are we throwing out?
+        size_t skipped = 0;
+        
+        while(referenceBase == 0 && skipped < sequence.size() &&
+            !is_reference_base(sequence[skipped])) {
+            
+            // If the path leads with invalid characters (like "X"), throw them
+            // out when computing reference path positions.
+            
+            // TODO: this is a hack to deal with the debruijn-brca1-k63 graph,
+            // which leads with an X.
+            
+            std::cerr << "Warning: dropping invalid leading character "
+                << sequence[skipped] << " from node " << node->id()
+                << std::endl;
+                
+            skipped++;
+        }
+        
+        // How many bases does this node actually contribute?
+        size_t contributed = sequence.size() - skipped;
+        
+        if(packSequence) {
+            // Pack the bases in reference order.
+            if(mapping.position().is_reverse()) {
+                for(size_t i = sequence.size(); i > skipped; i--) {
+                    index.packed.push_back(COMPLEMENT[sequence[i - 1]]);
+                }
+            } else {
+                for(size_t i = skipped; i < sequence.size(); i++) {
+                    index.packed.push_back(sequence[i]);
+                }
+            }
+        } else if(mapping.position().is_reverse()) {
+            // Put the reverse sequence in the reference path
+            reverse_complement_into(sequence.data() + skipped, contributed,
+                &index.sequence[referenceBase]);
+        } else {
+            // Put the forward sequence in the reference path
+            std::copy(sequence.begin() + skipped, sequence.end(),
+                index.sequence.begin() + referenceBase);
+        }
+            
+        // Say that this node appears here along the reference in this
+        // orientation.
+        index.byStart[referenceBase] = vg::NodeTraversal(node, mapping.position().is_reverse()); 
+            
+        // Whether we found the right place for this node in the reference or
+        // not, we still need to advance along the reference path. We assume the
+        // whole node (except any leading bogus characters) is included in the
+        // path (since it sort of has to be, syntactically, unless it's the
+        // first or last node).
+        referenceBase += contributed;
+        
+        // TODO: handle leading bogus characters in calls on the first node.
+    }
+    
+    if(!packSequence) {
+        // Drop any space left over from leading bogus characters.
+        index.sequence.resize(referenceBase);
+    }
+    
+    // Announce progress.
+    std::cerr << "Traced " << referenceBase << " bp reference path " << refPathName << "." << std::endl;
+    
+    if(index.size() < 100) {
+        std::cerr << "Reference sequence: " << index.substr(0) << std::endl;
+    }
+    
+    // Give back the indexes we have been making
+    return index;
+}
+
+// Magic number at the start of every reference trace cache file. Bump the
+// number on the end when the format changes.
+const static char REFERENCE_CACHE_MAGIC[8] = {'G', '2', 'V', 'R', 'E', 'F', '0', '2'};
+
+/**
+ * Compute a checksum of what goes into tracing the given reference path: the
+ * IDs and orientations of the nodes it visits, and their sequences. If this
+ * checksum matches, a cached trace of the path is still good. The sequences
+ * are hashed 8 bases at a time, so this is still much cheaper than tracing.
+ */
+static uint64_t reference_path_checksum(vg::VG& vg, const std::string& refPathName) {
+    // Mix in a whole word at a time, FNV-1a style, with a final avalanche
+    uint64_t hash = 14695981039346656037ULL;
+    auto mix = [&](uint64_t word) {
+        hash ^= word;
+        hash *= 1099511628211ULL;
+        hash ^= hash >> 29;
+    };
+    
+    for(const auto& mapping : vg.paths.get_path(refPathName)) {
+        int64_t nodeId = mapping.position().node_id();
+        const std::string& sequence = vg.get_node(nodeId)->sequence();
+        mix((uint64_t)nodeId);
+        mix(((uint64_t)sequence.size() << 1) | mapping.position().is_reverse());
+        
+        // The length is already in, so zero padding the last word is safe
+        size_t i = 0;
+        for(; i + sizeof(uint64_t) <= sequence.size(); i += sizeof(uint64_t)) {
+            uint64_t word;
+            memcpy(&word, sequence.data() + i, sizeof(word));
+            mix(word);
+        }
+        if(i < sequence.size()) {
+            uint64_t word = 0;
+            memcpy(&word, sequence.data() + i, sequence.size() - i);
+            mix(word);
+        }
+    }
+    
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdULL;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+/**
+ * Save a traced reference index to the given binary stream, tagged with the
+ * name and checksum of the path it was traced from.
+ */
+static void save_reference_index(const ReferenceIndex& index, uint64_t checksum,
+    const std::string& refPathName, std::ostream& out) {
+    
+    out.write(REFERENCE_CACHE_MAGIC, sizeof(REFERENCE_CACHE_MAGIC));
+    write_binary(out, checksum);
+    write_binary(out, (uint64_t)refPathName.size());
+    out.write(refPathName.data(), refPathName.size());
+    write_binary(out, (uint8_t)index.isPacked);
+    
+    // Each index is stored as columns, so it can be read back in bulk.
+    std::vector<int64_t> nodeIds;
+    std::vector<uint64_t> starts;
+    std::vector<uint8_t> backwards;
+    for(auto& idAndPlacement : index.byId) {
+        nodeIds.push_back(idAndPlacement.first);
+        starts.push_back(idAndPlacement.second.first);
+        backwards.push_back(idAndPlacement.second.second);
+    }
+    write_binary(out, (uint64_t)nodeIds.size());
+    out.write((const char*)nodeIds.data(), nodeIds.size() * sizeof(int64_t));
+    out.write((const char*)starts.data(), starts.size() * sizeof(uint64_t));
+    out.write((const char*)backwards.data(), backwards.size());
+    
+    nodeIds.clear();
+    starts.clear();
+    backwards.clear();
+    for(auto& startAndTraversal : index.byStart) {
+        starts.push_back(startAndTraversal.first);
+        nodeIds.push_back(startAndTraversal.second.node->id());
+        backwards.push_back(startAndTraversal.second.backward);
+    }
+    write_binary(out, (uint64_t)starts.size());
+    out.write((const char*)starts.data(), starts.size() * sizeof(uint64_t));
+    out.write((const char*)nodeIds.data(), nodeIds.size() * sizeof(int64_t));
+    out.write((const char*)backwards.data(), backwards.size());
+    
+    if(index.isPacked) {
+        index.packed.serialize(out);
+    } else {
+        write_binary(out, (uint64_t)index.sequence.size());
+        out.write(index.sequence.data(), index.sequence.size());
+    }
+}
+
+/**
+ * Try to load a reference index from the given binary stream. Returns true and
+ * fills in index if the stream holds an index for the given path with the given
+ * checksum and packing, and false otherwise (in which case the path needs to be
+ * traced again).
+ */
+static bool load_reference_index(std::istream& in, vg::VG& vg, uint64_t checksum,
+    const std::string& refPathName, bool packSequence, ReferenceIndex& index) {
+    
+    char magic[sizeof(REFERENCE_CACHE_MAGIC)];
+    if(!in.read(magic, sizeof(magic)) ||
+        !std::equal(magic, magic + sizeof(magic), REFERENCE_CACHE_MAGIC)) {
+        std::cerr << "Warning: reference cache is not in a format we understand" << std::endl;
+        return false;
+    }
+    
+    uint64_t cachedChecksum;
+    uint64_t nameLength;
+    if(!read_binary(in, cachedChecksum) || !read_binary(in, nameLength)) {
+        return false;
+    }
+    std::string cachedName(nameLength, '\0');
+    uint8_t cachedPacked;
+    if(!in.read(&cachedName[0], nameLength) || !read_binary(in, cachedPacked)) {
+        return false;
+    }
+    
+    if(cachedChecksum != checksum || cachedName != refPathName || (bool)cachedPacked != packSequence) {
+        // This cache is for something else.
+        std::cerr << "Reference cache does not match path " << refPathName << std::endl;
+        return false;
+    }
+    
+    // Everything after the header should be there, so a short read means a
+    // truncated file.
+    ReferenceIndex loaded;
+    loaded.isPacked = packSequence;
+    
+    std::vector<int64_t> nodeIds;
+    std::vector<uint64_t> starts;
+    std::vector<uint8_t> backwards;
+    /**
+     * Read in one index's columns, in the given order. Returns false if the
+     * file is truncated.
+     */
+    auto readColumns = [&](bool startsFirst) {
+        uint64_t count;
+        if(!read_binary(in, count)) {
+            return false;
+        }
+        nodeIds.resize(count);
+        starts.resize(count);
+        backwards.resize(count);
+        char* first = startsFirst ? (char*)starts.data() : (char*)nodeIds.data();
+        char* second = startsFirst ? (char*)nodeIds.data() : (char*)starts.data();
+        return (bool)in.read(first, count * 8) && (bool)in.read(second, count * 8) &&
+            (bool)in.read((char*)backwards.data(), count);
+    };
+    
+    if(!readColumns(false)) {
+        return false;
+    }
+    for(size_t i = 0; i < nodeIds.size(); i++) {
+        // Entries come out in sorted order, so always insert at the end.
+        loaded.byId.emplace_hint(loaded.byId.end(), nodeIds[i], std::make_pair((size_t)starts[i], (bool)backwards[i]));
+    }
+    
+    if(!readColumns(true)) {
+        return false;
+    }
+    for(size_t i = 0; i < starts.size(); i++) {
+        loaded.byStart.emplace_hint(loaded.byStart.end(), starts[i],
+            vg::NodeTraversal(vg.get_node(nodeIds[i]), backwards[i]));
+    }
+    
+    if(packSequence) {
+        if(!loaded.packed.load(in)) {
+            return false;
+        }
+    } else {
+        uint64_t length;
+        if(!read_binary(in, length)) {
+            return false;
+        }
+        loaded.sequence.resize(length);
+        if(!in.read(&loaded.sequence[0], length)) {
+            return false;
+        }
+    }
+    
+    index = std::move(loaded);
+    
+    std::cerr << "Loaded " << index.size() << " bp reference path " << refPathName
+        << " from cache." << std::endl;
+    return true;
+}
+
+/**
+ * Get the index for the given reference path, loading it from the given cache
+ * file if that file exists and matches the graph, and tracing the path and
+ * saving it there otherwise. If the cache filename is empty, just trace the
+ * path.
+ */
+static ReferenceIndex get_reference_index(vg::VG& vg, std::string refPathName,
+    bool packSequence, const std::string& cacheFile) {
+    
+    if(cacheFile.empty()) {
+        return trace_reference_path(vg, refPathName, packSequence);
+    }
+    
+    // The cache only knows about paths, so make sure ours exists before we
+    // hash it.
+    assert(vg.paths.has_path(refPathName));
+    uint64_t checksum = reference_path_checksum(vg, refPathName);
+    
+    ReferenceIndex index;
+    std::ifstream cacheIn(cacheFile, std::ios::binary);
+    if(cacheIn.good() && load_reference_index(cacheIn, vg, checksum, refPathName, packSequence, index)) {
+        return index;
+    }
+    cacheIn.close();
+    
+    // We need to actually do the trace
+    index = trace_reference_path(vg, refPathName, packSequence);
+    
+    // Write the cache under a name of our own and then move it into place, so
+    // other runs sharing the cache never see it half-written.
+    std::string tempFile = cacheFile + ".tmp" + std::to_string(getpid());
+    std::ofstream cacheOut(tempFile, std::ios::binary);
+    save_reference_index(index, checksum, refPathName, cacheOut);
+    cacheOut.close();
+    if(cacheOut.fail() || std::rename(tempFile.c_str(), cacheFile.c_str()) != 0) {
+        std::remove(tempFile.c_str());
+        std::cerr << "Warning: could not write reference cache " << cacheFile << std::endl;
+    } else {
+        std::cerr << "Saved reference path " << refPathName << " to cache " << cacheFile << std::endl;
+    }
+    
+    return index;
+}
+
+// Magic number at the start of every site catalog file. Bump the number on
+// the end when the format changes.
+const static char SITE_CATALOG_MAGIC[8] = {'G', '2', 'V', 'C', 'A', 'T', '0', '1'};
+
+/**
+ * Compute a checksum of the graph's topology: every node ID and every edge.
+ * Along with the reference path checksum, this tells us if a site catalog was
+ * made for this graph.
+ */
+static uint64_t graph_topology_checksum(vg::VG& vg) {
+    // Use 64-bit FNV-1a
+    uint64_t hash = 14695981039346656037ULL;
+    auto mix = [&](int64_t value) {
+        for(size_t i = 0; i < sizeof(value); i++) {
+            hash ^= (unsigned char)(value >> (i * 8));
+            hash *= 1099511628211ULL;
+        }
+    };
+    
+    vg.for_each_node([&](vg::Node* node) {
+        mix(node->id());
+    });
+    vg.for_each_edge([&](vg::Edge* edge) {
+        mix(edge->from());
+        mix(edge->from_start());
+        mix(edge->to());
+        mix(edge->to_end());
+    });
+    
+    return hash;
+}
+
+/**
+ * The bubble found from each non-reference node when nothing is pruned for
+ * lack of support. Pruning only ever removes candidate paths, so if every node
+ * in a cataloged bubble has support in a sample, that bubble is also what a
+ * search of the sample's pruned graph would find. Sites whose bubbles aren't
+ * fully supported, and sites that ran out of search budget when the catalog
+ * was made, still need to be searched.
+ */
+class SiteCatalog {
+public:
+    /**
+     * Find the bubble for every non-reference node in the graph, searching
+     * to the given depth and within the given budget for each.
+     */
+    SiteCatalog(vg::VG& vg, const ReferenceIndex& index, int64_t maxDepth, const SearchBudget& budget) :
+        maxDepth(maxDepth) {
+        
+        // Search the whole graph, with nothing pruned.
+        NodeAdjacency adjacency(vg, index);
+        
+        std::vector<vg::Node*> starts;
+        vg.for_each_node([&](vg::Node* node) {
+            if(!index.byId.count(node->id())) {
+                starts.push_back(node);
+            }
+        });
+        
+        // Searches are independent, so do them all at once.
+        std::vector<std::vector<vg::NodeTraversal>> found(starts.size());
+        std::vector<uint8_t> complete(starts.size());
+#pragma omp parallel for schedule(dynamic, 64)
+        for(size_t i = 0; i < starts.size(); i++) {
+            SearchBudget searchBudget = budget;
+            searchBudget.start();
+            found[i] = find_bubble(adjacency, starts[i], index, maxDepth, &searchBudget);
+            complete[i] = !searchBudget.exceeded;
+        }
+        
+        for(size_t i = 0; i < starts.size(); i++) {
+            if(complete[i]) {
+                bubbles[starts[i]->id()] = std::move(found[i]);
+            }
+        }
+    }
+    
+    /**
+     * Load a catalog from the given binary stream. Throws std::runtime_error
+     * if it isn't a catalog for the given reference path in this graph, with
+     * the given checksums.
+     */
+    SiteCatalog(std::istream& in, vg::VG& vg, uint64_t graphChecksum, uint64_t pathChecksum,
+        const std::string& refPathName) {
+        
+        char magic[sizeof(SITE_CATALOG_MAGIC)];
+        if(!in.read(magic, sizeof(magic)) ||
+            !std::equal(magic, magic + sizeof(magic), SITE_CATALOG_MAGIC)) {
+            throw std::runtime_error("Site catalog is not in a format we understand");
+        }
+        
+        uint64_t catalogGraphChecksum;
+        uint64_t catalogPathChecksum;
+        uint64_t nameLength;
+        if(!read_binary(in, catalogGraphChecksum) || !read_binary(in, catalogPathChecksum) ||
+            !read_binary(in, nameLength)) {
+            throw std::runtime_error("Site catalog is truncated");
+        }
+        std::string catalogName(nameLength, '\0');
+        if(!in.read(&catalogName[0], nameLength) || !read_binary(in, maxDepth)) {
+            throw std::runtime_error("Site catalog is truncated");
+        }
+        
+        if(catalogGraphChecksum != graphChecksum || catalogPathChecksum != pathChecksum ||
+            catalogName != refPathName) {
+            throw std::runtime_error("Site catalog was not made for this graph and reference path " + refPathName);
+        }
+        
+        uint64_t count;
+        if(!read_binary(in, count)) {
+            throw std::runtime_error("Site catalog is truncated");
+        }
+        for(uint64_t i = 0; i < count; i++) {
+            int64_t nodeId;
+            uint32_t length;
+            if(!read_binary(in, nodeId) || !read_binary(in, length)) {
+                throw std::runtime_error("Site catalog is truncated");
+            }
+            auto& bubble = bubbles[nodeId];
+            bubble.reserve(length);
+            for(uint32_t j = 0; j < length; j++) {
+                int64_t id;
+                uint8_t backward;
+                if(!read_binary(in, id) || !read_binary(in, backward)) {
+                    throw std::runtime_error("Site catalog is truncated");
+                }
+                bubble.emplace_back(vg.get_node(id), backward);
+            }
+        }
+    }
+    
+    /**
+     * Save the catalog to the given binary stream, tagged with the checksums
+     * and name of the graph and reference path it was made for.
+     */
+    void save(std::ostream& out, uint64_t graphChecksum, uint64_t pathChecksum,
+        const std::string& refPathName) const {
+        
+        out.write(SITE_CATALOG_MAGIC, sizeof(SITE_CATALOG_MAGIC));
+        write_binary(out, graphChecksum);
+        write_binary(out, pathChecksum);
+        write_binary(out, (uint64_t)refPathName.size());
+        out.write(refPathName.data(), refPathName.size());
+        write_binary(out, maxDepth);
+        
+        write_binary(out, (uint64_t)bubbles.size());
+        for(auto& idAndBubble : bubbles) {
+            write_binary(out, (int64_t)idAndBubble.first);
+            write_binary(out, (uint32_t)idAndBubble.second.size());
+            for(auto& traversal : idAndBubble.second) {
+                write_binary(out, (int64_t)traversal.node->id());
+                write_binary(out, (uint8_t)traversal.backward);
+            }
+        }
+    }
+    
+    /**
+     * Get the cataloged bubble for the given node, which is empty if there
+     * is no bubble. Returns null if the node's site still needs searching.
+     */
+    const std::vector<vg::NodeTraversal>* find(int64_t nodeId) const {
+        auto found = bubbles.find(nodeId);
+        return found == bubbles.end() ? nullptr : &found->second;
+    }
+    
+    /**
+     * Get the number of nodes deep the catalog's searches went.
+     */
+    int64_t max_depth() const {
+        return maxDepth;
+    }
+    
+    /**
+     * Get the number of sites in the catalog.
+     */
+    size_t size() const {
+        return bubbles.size();
+    }
+    
+private:
+    int64_t maxDepth;
+    // Bubble for each node ID, kept in order so saved catalogs are stable
+    std::map<int64_t, std::vector<vg::NodeTraversal>> bubbles;
+};
+
+/**
+ * A monotonic arena for the short-lived containers we build while emitting a
+ * single variant site. Allocation just bumps a pointer, freeing does nothing,
+ * and everything is handed back at once when the site is done. Blocks are kept
+ * between sites, so once the arena has grown to fit the biggest site it stops
+ * touching the system allocator.
+ *
+ * Each thread has its own arena, available from local().
+ */
+class SiteArena {
+public:
+    /**
+     * Get memory for the given number of bytes, aligned as requested.
+     */
+    void* allocate(size_t bytes, size_t alignment) {
+        while(currentBlock < blocks.size()) {
+            // See if it fits in the block we are filling
+            size_t start = (used + alignment - 1) / alignment * alignment;
+            if(start + bytes <= blocks[currentBlock].size) {
+                used = start + bytes;
+                return blocks[currentBlock].data.get() + start;
+            }
+            // Otherwise move on to the next block we have lying around.
+            currentBlock++;
+            used = 0;
+        }
+        
+        // We need a new block. Blocks come from new[], so they are aligned for
+        // anything we would put in a container.
+        Block block;
+        block.size = std::max(BLOCK_SIZE, bytes);
+        block.data.reset(new char[block.size]);
+        blocks.push_back(std::move(block));
+        currentBlock = blocks.size() - 1;
+        used = bytes;
+        return blocks.back().data.get();
+    }
+    
+    /**
+     * Make all the memory handed out available again. Anything allocated from
+     * the arena must be destroyed first.
+     */
+    void reset() {
+        currentBlock = 0;
+        used = 0;
+    }
+    
+    /**
+     * Get the arena for the calling thread.
+     */
+    static SiteArena& local() {
+        static thread_local SiteArena arena;
+        return arena;
+    }
+    
+    /**
+     * Resets the calling thread's arena when it goes out of scope. Declare one
+     * before any of a site's containers, so they are destroyed before it.
+     */
+    struct Scope {
+        ~Scope() {
+            SiteArena::local().reset();
+        }
+    };
+    
+private:
+    // How big should normal blocks be?
+    const static size_t BLOCK_SIZE = 64 * 1024;
+    
+    struct Block {
+        std::unique_ptr<char[]> data;
+        size_t size;
+    };
+    
+    std::vector<Block> blocks;
+    // Which block are we filling?
+    size_t currentBlock = 0;
+    // And how many bytes of it have we used?
+    size_t used = 0;
+};
+
+const size_t SiteArena::BLOCK_SIZE;
+
+/**
+ * A standard allocator that gets its memory from the calling thread's
+ * SiteArena.
+ */
+template<typename T>
+class ArenaAllocator {
+public:
+    typedef T value_type;
+    
+    ArenaAllocator() : arena(&SiteArena::local()) {
+        // Nothing to do
+    }
+    
+    template<typename U>
+    ArenaAllocator(const ArenaAllocator<U>& other) : arena(other.arena) {
+        // Nothing to do
+    }
+    
+    T* allocate(size_t count) {
+        return static_cast<T*>(arena->allocate(count * sizeof(T), alignof(T)));
+    }
+    
+    void deallocate(T*, size_t) {
+        // The memory comes back when the arena is reset.
+    }
+    
+    template<typename U>
+    bool operator==(const ArenaAllocator<U>& other) const {
+        return arena == other.arena;
+    }
+    
+    template<typename U>
+    bool operator!=(const ArenaAllocator<U>& other) const {
+        return arena != other.arena;
+    }
+    
+private:
+    template<typename U>
+    friend class ArenaAllocator;
+    
+    SiteArena* arena;
+};
+
+/**
+ * An ordered set for per-site temporaries, backed by the site arena.
+ */
+template<typename T>
+using SiteSet = std::set<T, std::less<T>, ArenaAllocator<T>>;
+
+/**
+ * A vector for per-site temporaries, backed by the site arena.
+ */
+template<typename T>
+using SiteVector = std::vector<T, ArenaAllocator<T>>;
+
+/**
+ * A set of original node id:offset cross-references.
+ */
+typedef SiteSet<std::pair<int64_t, size_t>> CrossreferenceSet;
+
+/**
+ * Given a collection of pileups by original node ID, and a set of original node
+ * id:offset cross-references in both ref and alt categories, produce a VCF
+ * comment line giving the pileup for each of those positions on those nodes.
+ * Includes a trailing newline if nonempty.
+ *
+ * TODO: VCF comments aren't really a thing.
+ */
+static std::string get_pileup_line(const std::map<int64_t, vg::NodePileup>& nodePileups,
+    const CrossreferenceSet& refCrossreferences,
+    const CrossreferenceSet& altCrossreferences) {
+    // We'll make a stringstream to write to.
+    std::stringstream out;
+    
+    out << "#";
+    
+    for(const auto& xref : refCrossreferences) {
+        // For every cross-reference
+        if(nodePileups.count(xref.first) && nodePileups.at(xref.first).base_pileup_size() > xref.second) {
+            // If we have that base pileup, grab it
+            auto basePileup = nodePileups.at(xref.first).base_pileup(xref.second);
+            
+            out << xref.first << ":" << xref.second << " (ref) " << basePileup.bases() << "\t";
+        }
+        // Nodes with no pileups (either no pileups were provided or they didn't
+        // appear/weren't visited by reads) will not be mentioned on this line
+    }
+    
+    for(const auto& xref : altCrossreferences) {
+        // For every cross-reference
+        if(nodePileups.count(xref.first) && nodePileups.at(xref.first).base_pileup_size() > xref.second) {
+            // If we have that base pileup, grab it
+            auto basePileup = nodePileups.at(xref.first).base_pileup(xref.second);
+            
+            out << xref.first << ":" << xref.second << " (alt) " << basePileup.bases() << "\t";
+        }
+        // Nodes with no pileups (either no pileups were provided or they didn't
+        // appear/weren't visited by reads) will not be mentioned on this line
+    }
+    // TODO: make these nearly-identical loops a loop or a lambda or something.
+    
+    if(out.str().size() > 1) {
+        // We actually found something. Send it out with a trailing newline
+        out << "\n";
+        return out.str();
+    } else {
+        // Give an empty string.
+        return "";
+    }
+}
+
+/**
+ * A queue with a maximum size, for handing work between threads. Pushing
+ * blocks while the queue is full, and popping blocks while it is empty and
+ * still open.
+ */
+template<typename T>
+class BoundedQueue {
+public:
+    BoundedQueue(size_t capacity) : capacity(capacity) {
+        // Nothing to do
+    }
+    
+    /**
+     * Add an item, waiting for room if necessary.
+     */
+    void push(T&& item) {
+        std::unique_lock<std::mutex> lock(mutex);
+        changed.wait(lock, [&]() { return items.size() < capacity; });
+        items.push_back(std::move(item));
+        lock.unlock();
+        changed.notify_all();
+    }
+    
+    /**
+     * Take the next item, waiting for one if necessary. Returns false if the
+     * queue has been closed and everything in it has been taken.
+     */
+    bool pop(T& item) {
+        std::unique_lock<std::mutex> lock(mutex);
+        changed.wait(lock, [&]() { return !items.empty() || closed; });
+        if(items.empty()) {
+            return false;
+        }
+        item = std::move(items.front());
+        items.pop_front();
+        lock.unlock();
+        changed.notify_all();
+        return true;
+    }
+    
+    /**
+     * Say that nothing more will be pushed.
+     */
+    void close() {
+        std::lock_guard<std::mutex> lock(mutex);
+        closed = true;
+        changed.notify_all();
+    }
+    
+private:
+    size_t capacity;
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::deque<T> items;
+    bool closed = false;
+};
+
+/**
+ * A stream buffer that reads a file on a background thread, optionally
+ * decompressing it with zlib, and hands the data over in large blocks. This
+ * lets decompression and I/O run at the same time as whatever is parsing the
+ * stream.
+ *
+ * When decompressing, files that aren't actually gzipped are passed through
+ * unchanged.
+ */
+class ThreadedInputBuffer : public std::streambuf {
+public:
+    /**
+     * Open the given file ("-" for standard input) and start reading it in the
+     * background. If decompress is set, gunzip it as we go. Check good() to
+     * see if the file could be opened. The file is only ever read straight
+     * through, so it can be a pipe.
+     */
+    ThreadedInputBuffer(const std::string& filename, bool decompress,
+        size_t blockSize = 1 << 20, size_t maxBlocks = 4) : filename(filename), blockSize(blockSize),
+        maxBlocks(maxBlocks) {
+        
+        // Work on our own copy of standard input's descriptor, so closing
+        // ours doesn't close it for everyone else.
+        int stdinCopy = filename == "-" ? dup(STDIN_FILENO) : -1;
+        
+        if(decompress) {
+            gzInput = filename == "-" ? (stdinCopy == -1 ? nullptr : gzdopen(stdinCopy, "rb")) :
+                gzopen(filename.c_str(), "rb");
+            if(gzInput != nullptr) {
+                // Let zlib read in big chunks too.
+                gzbuffer(gzInput, 1 << 17);
+            }
+        } else {
+            rawInput = filename == "-" ? (stdinCopy == -1 ? nullptr : fdopen(stdinCopy, "rb")) :
+                fopen(filename.c_str(), "rb");
+        }
+        if(stdinCopy != -1 && !good()) {
+            close(stdinCopy);
+        }
+        
+        if(good()) {
+            reader = std::thread(&ThreadedInputBuffer::read_blocks, this);
+        }
+    }
+    
+    ~ThreadedInputBuffer() {
+        {
+            // Tell the reader to stop, even if it has more to read.
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        changed.notify_all();
+        if(reader.joinable()) {
+            reader.join();
+        }
+        
+        if(gzInput != nullptr) {
+            gzclose(gzInput);
+        }
+        if(rawInput != nullptr) {
+            fclose(rawInput);
+        }
+    }
+    
+    /**
+     * Return true if the file was opened successfully.
+     */
+    bool good() const {
+        return gzInput != nullptr || rawInput != nullptr;
+    }
+    
+    /**
+     * Make the given stream, reading from this buffer, throw the error if the
+     * file can't be read, instead of just setting badbit and looking like it
+     * ended early.
+     */
+    void throw_errors_from(std::istream& stream) {
+        stream.exceptions(std::ios::badbit);
+    }
+    
+    /**
+     * Return true if the unread data starts with the given bytes, without
+     * consuming anything.
+     */
+    bool starts_with(const char* prefix, size_t length) {
+        if(gptr() == egptr() && underflow() == traits_type::eof()) {
+            return false;
+        }
+        return (size_t)(egptr() - gptr()) >= length && std::equal(prefix, prefix + length, gptr());
+    }
+    
+protected:
+    /**
+     * Get the next block from the reader thread when we run out.
+     */
+    int_type underflow() {
+        if(gptr() < egptr()) {
+            return traits_type::to_int_type(*gptr());
+        }
+        
+        std::unique_lock<std::mutex> lock(mutex);
+        changed.wait(lock, [&]() { return !ready.empty() || finished; });
+        
+        if(ready.empty()) {
+            // The reader has stopped
+            if(!error.empty()) {
+                // Streams catch this and set badbit, so anything reading
+                // through a stream needs throw_errors_from() to see it.
+                throw std::runtime_error(error);
+            }
+            return traits_type::eof();
+        }
+        
+        current = std::move(ready.front());
+        ready.pop_front();
+        lock.unlock();
+        // There's room for the reader to go on now.
+        changed.notify_all();
+        
+        setg(&current[0], &current[0], &current[0] + current.size());
+        return traits_type::to_int_type(*gptr());
+    }
+    
+private:
+    /**
+     * Read blocks until the end of the file, or until we're told to stop.
+     * Runs on the reader thread.
+     */
+    void read_blocks() {
+        while(true) {
+            {
+                // Wait for there to be room for another block.
+                std::unique_lock<std::mutex> lock(mutex);
+                changed.wait(lock, [&]() { return ready.size() < maxBlocks || stopping; });
+                if(stopping) {
+                    break;
+                }
+            }
+            
+            std::vector<char> block(blockSize);
+            int64_t bytesRead;
+            std::string readError;
+            if(gzInput != nullptr) {
+                bytesRead = gzread(gzInput, &block[0], blockSize);
+                if(bytesRead <= 0) {
+                    // A truncated or corrupt file can just look like the end,
+                    // so ask zlib which it was.
+                    int errorNumber;
+                    const char* message = gzerror(gzInput, &errorNumber);
+                    if(errorNumber != Z_OK) {
+                        // zlib puts its own name for the file on the front
+                        std::string reason(message);
+                        size_t nameEnd = reason.rfind(": ");
+                        if(nameEnd != std::string::npos) {
+                            reason = reason.substr(nameEnd + 2);
+                        }
+                        readError = "Could not decompress " + filename + ": " + reason;
+                        bytesRead = -1;
+                    }
+                }
+            } else {
+                bytesRead = fread(&block[0], 1, blockSize, rawInput);
+                if(ferror(rawInput)) {
+                    readError = "Could not read " + filename;
+                    bytesRead = -1;
+                }
+            }
+            
+            std::lock_guard<std::mutex> lock(mutex);
+            if(bytesRead <= 0) {
+                // We hit the end, or an error
+                error = readError;
+                break;
+            }
+            block.resize(bytesRead);
+            ready.push_back(std::move(block));
+            changed.notify_all();
+        }
+        
+        std::lock_guard<std::mutex> lock(mutex);
+        finished = true;
+        changed.notify_all();
+    }
+
+    // What are we reading, for error messages?
+    std::string filename;
+    // How big should blocks be?
+    size_t blockSize;
+    // How many blocks can be waiting?
+    size_t maxBlocks;
+    
+    // Only one of these is open, depending on whether we are decompressing.
+    gzFile gzInput = nullptr;
+    FILE* rawInput = nullptr;
+    
+    // Protects everything below here
+    std::mutex mutex;
+    // Notified whenever a block is added or taken, or the reader stops.
+    std::condition_variable changed;
+    // Blocks read but not yet handed over
+    std::deque<std::vector<char>> ready;
+    // Set when the reader thread is done
+    bool finished = false;
+    // Set when the reader thread should stop early
+    bool stopping = false;
+    // Set if the reader thread hit an error
+    std::string error;
+    
+    // The block we're currently handing out
+    std::vector<char> current;
+    
+    // The thread doing the reading
+    std::thread reader;
+};
+
+/**
+ * Return true if the given filename ends in ".gz".
+ */
+static bool has_gzip_extension(const std::string& filename) {
+    return filename.size() >= 3 && filename.compare(filename.size() - 3, 3, ".gz") == 0;
+}
+
+/**
+ * A stream buffer that collects output in large blocks and writes them out on
+ * a background thread, so whoever is producing the output never waits on a
+ * write system call unless the disk falls a whole block behind. Two blocks
+ * take turns: one filling and one being written.
+ *
+ * Flushing a stream on this buffer hands off the current block but doesn't
+ * wait for it to be written. Call close() to wait for everything to be
+ * written.
+ */
+class ThreadedOutputBuffer : public std::streambuf {
+public:
+    /**
+     * Start writing to the given file, which is not closed when we are done.
+     */
+    ThreadedOutputBuffer(FILE* output, size_t blockSize = 4 << 20) : output(output), filled(2), empty(2) {
+        // Set up the block for the writer to hand back, and the one to fill.
+        empty.push(std::vector<char>(blockSize));
+        current.resize(blockSize);
+        setp(&current[0], &current[0] + current.size());
+        
+        writer = std::thread(&ThreadedOutputBuffer::write_blocks, this);
+    }
+    
+    ~ThreadedOutputBuffer() {
+        close();
+    }
+    
+    /**
+     * Write out everything we have been given, and stop the writer thread.
+     * Returns false if anything could not be written.
+     */
+    bool close() {
+        if(writer.joinable()) {
+            hand_off();
+            filled.close();
+            writer.join();
+            fflush(output);
+        }
+        return !failed && !ferror(output);
+    }
+    
+protected:
+    /**
+     * Hand off the full block and start on the other one.
+     */
+    int_type overflow(int_type c) {
+        hand_off();
+        if(!traits_type::eq_int_type(c, traits_type::eof())) {
+            *pptr() = traits_type::to_char_type(c);
+            pbump(1);
+        }
+        return traits_type::not_eof(c);
+    }
+    
+    /**
+     * Hand off what we have so far without waiting for it to be written.
+     */
+    int sync() {
+        if(pptr() != pbase()) {
+            hand_off();
+        }
+        return 0;
+    }
+    
+private:
+    /**
+     * Send the block we are filling to the writer, and get the other block
+     * back to fill, waiting if it is still being written.
+     */
+    void hand_off() {
+        current.resize(pptr() - pbase());
+        filled.push(std::move(current));
+        if(!empty.pop(current)) {
+            // The writer has gone away, so we just keep reusing a new block.
+            current.clear();
+        }
+        current.resize(current.capacity());
+        setp(&current[0], &current[0] + current.size());
+    }
+    
+    /**
+     * Write blocks as they come in, and hand them back to be filled again.
+     * Runs on the writer thread.
+     */
+    void write_blocks() {
+        std::vector<char> block;
+        while(filled.pop(block)) {
+            if(!block.empty() && fwrite(&block[0], 1, block.size(), output) != block.size()) {
+                failed = true;
+            }
+            empty.push(std::move(block));
+        }
+        empty.close();
+    }
+    
+    // Where does the output go?
+    FILE* output;
+    
+    // Blocks waiting to be written, and blocks waiting to be filled.
+    BoundedQueue<std::vector<char>> filled;
+    BoundedQueue<std::vector<char>> empty;
+    
+    // The block being filled
+    std::vector<char> current;
+    
+    // Set by the writer thread if a write fails.
+    std::atomic<bool> failed{false};
+    
+    // The thread doing the writing
+    std::thread writer;
+};
+
+
+CallWriter::CallWriter(const std::string& filename, const std::string& headerText, const std::string& contigName,
+    const std::vector<std::string>& sampleNames, bool bcf) : contigName(contigName), sampleNames(sampleNames) {
+    
+    if(bcf) {
+        bcfFile = hts_open(filename.c_str(), "wb");
+        if(bcfFile == nullptr) {
+            throw std::runtime_error("Could not open " + filename + " for BCF");
+        }
+        
+        // htslib makes its own fileformat line, so give it everything
+        // else from our header.
+        bcfHeader = bcf_hdr_init("w");
+        std::stringstream headerLines(headerText);
+        std::string line;
+        while(std::getline(headerLines, line)) {
+            if(line.compare(0, 2, "##") == 0 && line.compare(0, 13, "##fileformat=") != 0) {
+                bcf_hdr_append(bcfHeader, line.c_str());
+            }
+        }
+        for(auto& sampleName : sampleNames) {
+            bcf_hdr_add_sample(bcfHeader, sampleName.c_str());
+        }
+        bcf_hdr_sync(bcfHeader);
+        
+        contigId = bcf_hdr_name2id(bcfHeader, contigName.c_str());
+        if(contigId < 0) {
+            throw std::runtime_error("Contig " + contigName + " is not in the BCF header");
+        }
+        
+        if(bcf_hdr_write(bcfFile, bcfHeader) != 0) {
+            failed = true;
+        }
+        bcfRecord = bcf_init();
+    } else {
+        // Load the header into a VCF file object, so vcflib Variants can
+        // know which of their available info fields or whatever are
+        // defined, and so know what to output.
+        std::string header = headerText;
+        if(!vcf.openForOutput(header)) {
+            throw std::runtime_error("Could not parse VCF header");
+        }
+        
+        if(filename == "-") {
+            textFile = stdout;
+        } else {
+            textFile = fopen(filename.c_str(), "w");
+            if(textFile == nullptr) {
+                throw std::runtime_error("Could not open " + filename + " for writing");
+            }
+        }
+        
+        // All the VCF output goes through a big buffer written out on its
+        // own thread, so we never wait for a write while making calls.
+        textBuffer.reset(new ThreadedOutputBuffer(textFile));
+        textStream.reset(new std::ostream(textBuffer.get()));
+        
+        // Spit out the header
+        *textStream << headerText;
+    }
+}
+
+CallWriter::~CallWriter() {
+    close();
+}
+
+void CallWriter::write(const SiteCall& call, const std::string& pileupLine) {
+    if(bcfRecord != nullptr) {
+        write_bcf(call);
+    } else {
+        *textStream << to_variant(call, vcf, contigName, sampleNames) << "\n";
+        *textStream << pileupLine;
+    }
+}
+
+bool CallWriter::close() {
+    if(bcfFile != nullptr) {
+        if(hts_close(bcfFile) != 0) {
+            failed = true;
+        }
+        bcfFile = nullptr;
+        bcf_destroy(bcfRecord);
+        bcfRecord = nullptr;
+        bcf_hdr_destroy(bcfHeader);
+        bcfHeader = nullptr;
+    }
+    if(textBuffer) {
+        textStream->flush();
+        if(!textBuffer->close()) {
+            failed = true;
+        }
+        textStream.reset();
+        textBuffer.reset();
+    }
+    if(textFile != nullptr && textFile != stdout) {
+        if(fclose(textFile) != 0) {
+            failed = true;
+        }
+    }
+    textFile = nullptr;
+    return !failed;
+}
+
+void CallWriter::write_bcf(const SiteCall& call) {
+    bcf_clear(bcfRecord);
+    bcfRecord->rid = contigId;
+    bcfRecord->pos = call.position - 1;
+    bcfRecord->qual = call.quality;
+    bcf_update_id(bcfHeader, bcfRecord, call.id.c_str());
+    
+    std::string alleles = call.ref;
+    for(auto& alt : call.alt) {
+        alleles.push_back(',');
+        alleles += alt;
+    }
+    bcf_update_alleles_str(bcfHeader, bcfRecord, alleles.c_str());
+    
+    if(call.known) {
+        bcf_update_info_flag(bcfHeader, bcfRecord, "XREF", nullptr, 1);
+    }
+    if(!call.crossreferences.empty()) {
+        std::string crossreferences;
+        for(auto& crossreference : call.crossreferences) {
+            if(!crossreferences.empty()) {
+                crossreferences.push_back(',');
+            }
+            crossreferences += std::to_string(crossreference.first) + ":" +
+                std::to_string(crossreference.second);
+        }
+        bcf_update_info_string(bcfHeader, bcfRecord, "XSEE", crossreferences.c_str());
+    }
+    if(!call.svType.empty()) {
+        // Describe the symbolic allele
+        bcf_update_info_string(bcfHeader, bcfRecord, "SVTYPE", call.svType.c_str());
+        int32_t end = call.end;
+        bcf_update_info_int32(bcfHeader, bcfRecord, "END", &end, 1);
+        int32_t svLength = call.svLength;
+        bcf_update_info_int32(bcfHeader, bcfRecord, "SVLEN", &svLength, 1);
+    }
+    
+    // The variant depth is the total over the samples
+    int32_t depth = call.depth();
+    bcf_update_info_int32(bcfHeader, bcfRecord, "DP", &depth, 1);
+    
+    if(call.referenceBlock) {
+        // Reference blocks just say how far they go and how deep they are.
+        int32_t end = call.end;
+        bcf_update_info_int32(bcfHeader, bcfRecord, "END", &end, 1);
+        
+        std::vector<int32_t> genotypes, depths, minDepths;
+        for(auto& sample : call.samples) {
+            for(size_t i = 0; i < 2; i++) {
+                genotypes.push_back(sample.genotype[i] == -1 ? bcf_gt_missing : bcf_gt_unphased(sample.genotype[i]));
+            }
+            depths.push_back(sample.depth());
+            minDepths.push_back(sample.minDepth);
+        }
+        bcf_update_genotypes(bcfHeader, bcfRecord, genotypes.data(), genotypes.size());
+        bcf_update_format_int32(bcfHeader, bcfRecord, "DP", depths.data(), depths.size());
+        bcf_update_format_int32(bcfHeader, bcfRecord, "MIN_DP", minDepths.data(), minDepths.size());
+    } else {
+        // htslib wants each FORMAT field for all the samples in one flat
+        // array, sample by sample.
+        size_t sampleCount = call.samples.size();
+        // There's an allele depth for the ref and alt, and any <NON_REF>.
+        size_t alleleCount = std::max<size_t>(call.alleles.size(), 2);
+        std::vector<int32_t> genotypes, depths, alleleDepths, strandBiases, altDepths;
+        std::vector<float> likelihoods;
+        for(auto& sample : call.samples) {
+            for(size_t i = 0; i < 2; i++) {
+                genotypes.push_back(sample.genotype[i] == -1 ? bcf_gt_missing : bcf_gt_unphased(sample.genotype[i]));
+            }
+            depths.push_back(sample.depth());
+            alleleDepths.push_back(round(total(sample.refSupport)));
+            alleleDepths.push_back(round(total(sample.altSupport)));
+            alleleDepths.resize(alleleCount * depths.size(), 0);
+            strandBiases.push_back(round(sample.refSupport.first));
+            strandBiases.push_back(round(sample.refSupport.second));
+            strandBiases.push_back(round(sample.altSupport.first));
+            strandBiases.push_back(round(sample.altSupport.second));
+            altDepths.push_back(round(total(sample.altSupport)));
+            likelihoods.push_back(sample.refLikelihood);
+            likelihoods.push_back(sample.altLikelihood);
+        }
+        bcf_update_genotypes(bcfHeader, bcfRecord, genotypes.data(), 2 * sampleCount);
+        bcf_update_format_int32(bcfHeader, bcfRecord, "DP", depths.data(), sampleCount);
+        bcf_update_format_int32(bcfHeader, bcfRecord, "AD", alleleDepths.data(), alleleCount * sampleCount);
+        bcf_update_format_int32(bcfHeader, bcfRecord, "SB", strandBiases.data(), 4 * sampleCount);
+        bcf_update_format_int32(bcfHeader, bcfRecord, "XAAD", altDepths.data(), sampleCount);
+        bcf_update_format_float(bcfHeader, bcfRecord, "AL", likelihoods.data(), 2 * sampleCount);
+    }
+    
+    if(bcf_write(bcfFile, bcfHeader, bcfRecord) != 0) {
+        failed = true;
+    }
+}
+
+
+/**
+ * An open-addressing hash table from the pair of NodeSides an edge connects to
+ * the edge itself, built once after the graph is loaded. Finding an edge is a
+ * single probe sequence over one flat array, instead of separate has_edge and
+ * get_edge lookups in vg's general-purpose edge maps.
+ */
+class EdgeIndex {
+public:
+    /**
+     * Make an empty index.
+     */
+    EdgeIndex() {
+        // Nothing to do
+    }
+    
+    /**
+     * Index all the edges in the given graph.
+     */
+    EdgeIndex(vg::VG& graph) {
+        // Keep the table at most half full
+        size_t capacity = 16;
+        while(capacity < graph.edge_count() * 2) {
+            capacity *= 2;
+        }
+        slots.resize(capacity);
+        mask = capacity - 1;
+        
+        graph.for_each_edge([&](vg::Edge* edge) {
+            // Edges attach to the end of their from node unless they are
+            // from_start, and to the start of their to node unless they are
+            // to_end.
+            insert(vg::NodeSide(edge->from(), !edge->from_start()),
+                vg::NodeSide(edge->to(), edge->to_end()), edge);
+        });
+    }
+    
+    /**
+     * Find the edge connecting the given pair of sides, in either order, or
+     * null if there isn't one.
+     */
+    vg::Edge* find(const std::pair<vg::NodeSide, vg::NodeSide>& sides) const {
+        if(slots.empty()) {
+            return nullptr;
+        }
+        
+        uint64_t low;
+        uint64_t high;
+        pack(sides.first, sides.second, low, high);
+        
+        for(size_t slot = hash(low, high) & mask; slots[slot].edge != nullptr; slot = (slot + 1) & mask) {
+            if(slots[slot].low == low && slots[slot].high == high) {
+                return slots[slot].edge;
+            }
+        }
+        return nullptr;
+    }
+    
+private:
+    struct Slot {
+        // The packed sides the edge connects, lower one first.
+        uint64_t low = 0;
+        uint64_t high = 0;
+        // The edge, or null for an empty slot.
+        vg::Edge* edge = nullptr;
+    };
+    
+    /**
+     * Pack a pair of sides into two words, ordered so the same edge always
+     * gets the same key.
+     */
+    static void pack(const vg::NodeSide& a, const vg::NodeSide& b, uint64_t& low, uint64_t& high) {
+        uint64_t packedA = ((uint64_t)a.node << 1) | a.is_end;
+        uint64_t packedB = ((uint64_t)b.node << 1) | b.is_end;
+        low = std::min(packedA, packedB);
+        high = std::max(packedA, packedB);
+    }
+    
+    /**
+     * Mix a packed key into a hash value.
+     */
+    static size_t hash(uint64_t low, uint64_t high) {
+        uint64_t mixed = low * 0x9E3779B97F4A7C15ULL ^ (high + 0x632BE59BD9B4E019ULL);
+        mixed ^= mixed >> 29;
+        mixed *= 0xBF58476D1CE4E5B9ULL;
+        mixed ^= mixed >> 32;
+        return mixed;
+    }
+    
+    /**
+     * Add an edge to the table. The table must not be full.
+     */
+    void insert(const vg::NodeSide& a, const vg::NodeSide& b, vg::Edge* edge) {
+        uint64_t low;
+        uint64_t high;
+        pack(a, b, low, high);
+        
+        size_t slot = hash(low, high) & mask;
+        while(slots[slot].edge != nullptr && !(slots[slot].low == low && slots[slot].high == high)) {
+            slot = (slot + 1) & mask;
+        }
+        slots[slot].low = low;
+        slots[slot].high = high;
+        slots[slot].edge = edge;
+    }
+    
+    std::vector<Slot> slots;
+    size_t mask = 0;
+};
+
+
+// Magic number at the start of every binary Glenn call file. Bump the number on
+// the end when the format changes.
+const static char GLENN_BINARY_MAGIC[8] = {'G', '2', 'V', 'C', 'A', 'L', 'L', '1'};
+
+/**
+ * Parse the lines of a chunk of a Glenn TSV file into columns. The chunk must
+ * hold only whole lines, and firstLine is the line number of its first line.
+ * Does not check the records against any graph.
+ */
+static void parse_glenn_lines(const char* chunkStart, const char* chunkEnd, uint64_t firstLine, GlennCalls& calls) {
+
+    // Loop through all the lines
+    std::string line;
+    size_t lineNumber = firstLine - 1;
+    const char* cursor = chunkStart;
+    while(cursor < chunkEnd) {
+        // For each line
+        const char* lineEnd = std::find(cursor, chunkEnd, '\n');
+        line.assign(cursor, lineEnd);
+        cursor = lineEnd == chunkEnd ? chunkEnd : lineEnd + 1;
+        
+        lineNumber++;
+        calls.lineCount++;
+        
+        if(line == "") {
+            // Skip blank lines
+            continue;
+        }
+        
+        // Make a stringstream to read out tokens
+        std::stringstream tokens(line);
+        
+        // Read the kind of line this is ("N"ode or "E"dge)
+        std::string lineType;
+        tokens >> lineType; 
+        
+        if(lineType == "N") {
+            // This is a line about a node
+            
+            // Read the node ID
+            int64_t nodeId;
+            tokens >> nodeId;
+            
+            // What kind of call is it? Could be "U"ncalled, or "R"eference
+            // (i.e. known in the original graph), which we have special
+            // handling for.
+            std::string callType;
+            tokens >> callType;
+                        
+            // Read the read support
+            Support readSupport;
+            int other_support = 0;
+            double likelihood = 0.;
+            bool hasSupport = (tokens >> readSupport.first) && (tokens >> readSupport.second) &&
+               (tokens >> other_support) && (tokens >> likelihood);
+               
+            // Load the original node ID and offset for this node, if present.
+            int64_t originalId = 0;
+            size_t originalOffset = 0;
+            if(!(tokens >> originalId && tokens >> originalOffset)) {
+                originalId = 0;
+                originalOffset = 0;
+            }
+            
+            calls.nodeIds.push_back(nodeId);
+            calls.nodeCallTypes.push_back(callType.empty() ? '.' : callType[0]);
+            calls.nodeHasSupport.push_back(hasSupport);
+            calls.nodeForwardSupport.push_back(hasSupport ? readSupport.first : 0);
+            calls.nodeReverseSupport.push_back(hasSupport ? readSupport.second : 0);
+            calls.nodeOtherSupport.push_back(hasSupport ? other_support : 0);
+            calls.nodeLikelihoods.push_back(hasSupport ? likelihood : 0);
+            calls.nodeOriginalIds.push_back(originalId);
+            calls.nodeOriginalOffsets.push_back(originalOffset);
+            calls.nodeLines.push_back(lineNumber);
+            
+        } else if(lineType == "E") {
+        
+            // Read the edge data
+            std::string edgeDescription;
+            tokens >> edgeDescription;
+            
+            // Split on commas. Don't use a regex here; building one for every
+            // line is slow.
+            std::vector<string> parts;
+            size_t fieldStart = 0;
+            size_t comma;
+            while((comma = edgeDescription.find(',', fieldStart)) != std::string::npos) {
+                parts.push_back(edgeDescription.substr(fieldStart, comma - fieldStart));
+                fieldStart = comma + 1;
+            }
+            parts.push_back(edgeDescription.substr(fieldStart));
+            
+            // We need the four fields to describe an edge.
+            assert(parts.size() == 4);
+            
+            // Parse the mode
+            std::string mode;
+            tokens >> mode;
+            
+            // Read the read support
+            Support readSupport;
+            int other_support = 0;
+            double likelihood = 0.;
+            bool hasSupport = (tokens >> readSupport.first) && (tokens >> readSupport.second) &&
+               (tokens >> other_support) && (tokens >> likelihood);
+            
+            // Parse the from node and the from_start flag, and the to node and
+            // the to_end flag. Do it all before adding anything, so the columns
+            // stay the same length if a field is bad.
+            int64_t from = std::stoll(parts[0]);
+            bool fromStart = (bool)std::stoi(parts[1]);
+            int64_t to = std::stoll(parts[2]);
+            bool toEnd = (bool)std::stoi(parts[3]);
+            
+            calls.edgeFroms.push_back(from);
+            calls.edgeFromStarts.push_back(fromStart);
+            calls.edgeTos.push_back(to);
+            calls.edgeToEnds.push_back(toEnd);
+            calls.edgeModes.push_back((mode == "L" || mode == "R") ? mode[0] : '.');
+            calls.edgeHasSupport.push_back(hasSupport);
+            calls.edgeForwardSupport.push_back(hasSupport ? readSupport.first : 0);
+            calls.edgeReverseSupport.push_back(hasSupport ? readSupport.second : 0);
+            calls.edgeOtherSupport.push_back(hasSupport ? other_support : 0);
+            calls.edgeLikelihoods.push_back(hasSupport ? likelihood : 0);
+            calls.edgeLines.push_back(lineNumber);
+        
+        } else {
+            // This is not a real kind of line
+            throw std::runtime_error("Line " + std::to_string(lineNumber) + ": Unknown line type: " + lineType);
+        }
+        
+    }
+}
+
+/**
+ * Read the next chunk of whole lines, of about the given size, from a Glenn TSV
+ * stream. carry holds any partial line left over from the last chunk, and gets
+ * any partial line left over from this one. Returns false if there was
+ * nothing left to read.
+ */
+static bool read_glenn_chunk(std::istream& tsvStream, std::string& carry, std::string& chunk, size_t chunkBytes) {
+    // Start with the leftover partial line, which has no newlines in it.
+    chunk.swap(carry);
+    carry.clear();
+    
+    while(tsvStream) {
+        // Read some more
+        size_t oldSize = chunk.size();
+        chunk.resize(oldSize + chunkBytes);
+        tsvStream.read(&chunk[oldSize], chunkBytes);
+        chunk.resize(oldSize + tsvStream.gcount());
+        
+        size_t lastNewline = chunk.rfind('\n');
+        if(lastNewline != std::string::npos) {
+            // Save anything after the last whole line for next time.
+            carry.assign(chunk, lastNewline + 1, std::string::npos);
+            chunk.resize(lastNewline + 1);
+            break;
+        }
+        // Otherwise we're in the middle of a really long line, or at EOF.
+    }
+    
+    if(tsvStream.bad()) {
+        // Don't pass a read error off as the end of the file
+        throw std::runtime_error("Could not read Glenn calls");
+    }
+    
+    return !chunk.empty();
+}
+
+/**
+ * Read the records from a Glenn TSV stream into columns, handing them off in
+ * batches to the given function, in file order. Chunks of lines are parsed in
+ * parallel. Returns the number of lines read.
+ */
+static uint64_t read_glenn_tsv(std::istream& tsvStream, const std::function<void(GlennCalls&)>& handleBatch,
+    size_t chunkBytes = 4 << 20) {
+    
+    // Parse this many chunks at once
+    size_t chunksPerBatch = omp_get_max_threads();
+    
+    std::string carry;
+    uint64_t linesRead = 0;
+    bool moreToRead = true;
+    while(moreToRead) {
+        // Read a batch of chunks on this thread, and work out the line number
+        // each one starts at.
+        std::vector<std::string> chunks;
+        std::vector<uint64_t> firstLines;
+        while(chunks.size() < chunksPerBatch) {
+            std::string chunk;
+            if(!read_glenn_chunk(tsvStream, carry, chunk, chunkBytes)) {
+                moreToRead = false;
+                break;
+            }
+            firstLines.push_back(linesRead + 1);
+            // Chunks end in newlines, except maybe the last one.
+            linesRead += std::count(chunk.begin(), chunk.end(), '\n') + (chunk.back() == '\n' ? 0 : 1);
+            chunks.push_back(std::move(chunk));
+        }
+        
+        // Parse them all in parallel
+        std::vector<GlennCalls> parsed(chunks.size());
+        std::vector<std::exception_ptr> errors(chunks.size());
+#pragma omp parallel for schedule(dynamic, 1)
+        for(size_t i = 0; i < chunks.size(); i++) {
+            try {
+                parse_glenn_lines(chunks[i].data(), chunks[i].data() + chunks[i].size(), firstLines[i], parsed[i]);
+            } catch(...) {
+                // We can't throw out of OpenMP, so hold on to it.
+                errors[i] = std::current_exception();
+            }
+        }
+        
+        for(size_t i = 0; i < chunks.size(); i++) {
+            // Hand off the batches in file order. A chunk that failed to parse
+            // still has the records from before the bad line, and those go out
+            // first, so anything wrong with them is found before the error.
+            handleBatch(parsed[i]);
+            if(errors[i]) {
+                std::rethrow_exception(errors[i]);
+            }
+        }
+    }
+    
+    return linesRead;
+}
+
+/**
+ * Write out one column of a binary Glenn call file.
+ */
+template<typename T>
+static void write_column(std::ostream& out, const std::vector<T>& column) {
+    out.write((const char*)column.data(), column.size() * sizeof(T));
+}
+
+/**
+ * Read in one column of a binary Glenn call file, with the given number of
+ * entries. Throws if the file is truncated.
+ */
+template<typename T>
+static void read_column(std::istream& in, std::vector<T>& column, size_t count) {
+    column.resize(count);
+    if(!in.read((char*)column.data(), count * sizeof(T))) {
+        throw std::runtime_error("Binary call file is truncated");
+    }
+}
+
+/**
+ * Write the given calls to a binary Glenn call file, stored by column.
+ */
+void write_glenn_binary(const GlennCalls& calls, std::ostream& out) {
+    out.write(GLENN_BINARY_MAGIC, sizeof(GLENN_BINARY_MAGIC));
+    write_binary(out, calls.lineCount);
+    
+    write_binary(out, (uint64_t)calls.nodeIds.size());
+    write_column(out, calls.nodeIds);
+    write_column(out, calls.nodeCallTypes);
+    write_column(out, calls.nodeHasSupport);
+    write_column(out, calls.nodeForwardSupport);
+    write_column(out, calls.nodeReverseSupport);
+    write_column(out, calls.nodeOtherSupport);
+    write_column(out, calls.nodeLikelihoods);
+    write_column(out, calls.nodeOriginalIds);
+    write_column(out, calls.nodeOriginalOffsets);
+    write_column(out, calls.nodeLines);
+    
+    write_binary(out, (uint64_t)calls.edgeFroms.size());
+    write_column(out, calls.edgeFroms);
+    write_column(out, calls.edgeFromStarts);
+    write_column(out, calls.edgeTos);
+    write_column(out, calls.edgeToEnds);
+    write_column(out, calls.edgeModes);
+    write_column(out, calls.edgeHasSupport);
+    write_column(out, calls.edgeForwardSupport);
+    write_column(out, calls.edgeReverseSupport);
+    write_column(out, calls.edgeOtherSupport);
+    write_column(out, calls.edgeLikelihoods);
+    write_column(out, calls.edgeLines);
+}
+
+/**
+ * Read calls from a binary Glenn call file, after the magic number has already
+ * been consumed. Throws if the file is truncated.
+ */
+static GlennCalls read_glenn_binary(std::istream& in) {
+    GlennCalls calls;
+    
+    uint64_t count;
+    if(!read_binary(in, calls.lineCount) || !read_binary(in, count)) {
+        throw std::runtime_error("Binary call file is truncated");
+    }
+    read_column(in, calls.nodeIds, count);
+    read_column(in, calls.nodeCallTypes, count);
+    read_column(in, calls.nodeHasSupport, count);
+    read_column(in, calls.nodeForwardSupport, count);
+    read_column(in, calls.nodeReverseSupport, count);
+    read_column(in, calls.nodeOtherSupport, count);
+    read_column(in, calls.nodeLikelihoods, count);
+    read_column(in, calls.nodeOriginalIds, count);
+    read_column(in, calls.nodeOriginalOffsets, count);
+    read_column(in, calls.nodeLines, count);
+    
+    if(!read_binary(in, count)) {
+        throw std::runtime_error("Binary call file is truncated");
+    }
+    read_column(in, calls.edgeFroms, count);
+    read_column(in, calls.edgeFromStarts, count);
+    read_column(in, calls.edgeTos, count);
+    read_column(in, calls.edgeToEnds, count);
+    read_column(in, calls.edgeModes, count);
+    read_column(in, calls.edgeHasSupport, count);
+    read_column(in, calls.edgeForwardSupport, count);
+    read_column(in, calls.edgeReverseSupport, count);
+    read_column(in, calls.edgeOtherSupport, count);
+    read_column(in, calls.edgeLikelihoods, count);
+    read_column(in, calls.edgeLines, count);
+    
+    return calls;
+}
+
+/**
+ * Read a Glenn call file, in either text or binary format, into columns, and
+ * hand the records off in batches, in file order, to the given function. The
+ * file may be gzipped, in which case it is decompressed on a separate thread
+ * while we parse. Returns the number of lines in the file.
+ */
+uint64_t read_glenn_file(const std::string& glennFile, const std::function<void(GlennCalls&)>& handleBatch) {
+    // Open up the file
+    ThreadedInputBuffer glennBuffer(glennFile, true);
+    if(!glennBuffer.good()) {
+        throw std::runtime_error("Could not read " + glennFile);
+    }
+    std::istream glennStream(&glennBuffer);
+    glennBuffer.throw_errors_from(glennStream);
+    
+    // Sniff for the binary magic number
+    if(glennBuffer.starts_with(GLENN_BINARY_MAGIC, sizeof(GLENN_BINARY_MAGIC))) {
+        glennStream.ignore(sizeof(GLENN_BINARY_MAGIC));
+        GlennCalls calls = read_glenn_binary(glennStream);
+        uint64_t lineCount = calls.lineCount;
+        handleBatch(calls);
+        return lineCount;
+    }
+    
+    // Otherwise it's text.
+    return read_glenn_tsv(glennStream, handleBatch);
+}
+
+/**
+ * Read a whole Glenn call file, in either text or binary format, into columns.
+ */
+GlennCalls read_glenn_file(const std::string& glennFile) {
+    GlennCalls calls;
+    calls.lineCount = read_glenn_file(glennFile, [&](GlennCalls& batch) {
+        calls.append(batch);
+    });
+    return calls;
+}
+
+/**
+ * Check node record i of a set of Glenn calls against the graph, and load it.
+ */
+static void load_glenn_node(const GlennCalls& calls, size_t i,
+               vg::VG& vg,
+               std::map<vg::Node*, Support>& nodeReadSupport,
+               std::map<vg::Node*, double>& nodeLikelihood,
+               std::map<vg::Node*, std::pair<int64_t, size_t>>& nodeSources,
+               std::set<vg::Node*>& knownNodes) {
+    int64_t nodeId = calls.nodeIds[i];
+    
+    if(!vg.has_node(nodeId)) {
+        throw std::runtime_error(calls.node_location(i) + ": Invalid node: " + std::to_string(nodeId));
+    }
+    
+    // Retrieve the node we're talking about 
+    vg::Node* nodePointer = vg.get_node(nodeId);
+    
+    if(calls.nodeHasSupport[i]) {
+        // For nodes with the number there, actually process the read support
+        Support readSupport = std::make_pair(calls.nodeForwardSupport[i], calls.nodeReverseSupport[i]);
+    
+#ifdef debug
+        std::cerr << calls.node_location(i) << ": Node " << nodeId
+            << " has read support " << readSupport.first << "," << readSupport.second << endl;
+#endif
+        
+        // Save it
+        nodeReadSupport[nodePointer] = readSupport;
+        nodeLikelihood[nodePointer] = calls.nodeLikelihoods[i];
+        
+        if(calls.nodeCallTypes[i] == 'R') {
+            // Note that this is a reference node
+            knownNodes.insert(nodePointer);
+        }
+    }
+    
+    if(calls.nodeOriginalIds[i] != 0) {
+        // Remember where the node came from
+        nodeSources[nodePointer] = std::make_pair(calls.nodeOriginalIds[i], (size_t)calls.nodeOriginalOffsets[i]);
+    }
+}
+
+/**
+ * Check edge record i of a set of Glenn calls against the graph, and load it.
+ */
+static void load_glenn_edge(const GlennCalls& calls, size_t i,
+               const EdgeIndex& edges,
+               std::map<vg::Edge*, Support>& edgeReadSupport,
+               std::map<vg::Edge*, double>& edgeLikelihood,
+               std::set<vg::Edge*>& deletionEdges,
+               std::set<vg::Edge*>& knownEdges) {
+    // Make NodeSides for the from and to sides
+    vg::NodeSide fromSide(calls.edgeFroms[i], !calls.edgeFromStarts[i]);
+    vg::NodeSide toSide(calls.edgeTos[i], calls.edgeToEnds[i]);
+    
+    // Get the edge
+    vg::Edge* edgePointer = edges.find(std::make_pair(fromSide, toSide));
+    
+    if(edgePointer == nullptr) {
+        // Ensure we really have that edge
+        throw std::runtime_error(calls.edge_location(i) + ": Edge " +
+            calls.edge_description(i) + " not in graph.");
+    }
+    
+    char mode = calls.edgeModes[i];
+    if(mode == 'L' || mode == 'R') {
+        // This is a deletion edge, or an edge in the primary path that
+        // may describe a nonzero-length deletion.
+#ifdef debug
+        std::cerr << calls.edge_location(i) << ": Edge "
+            << calls.edge_description(i) << " may describe a deletion." << endl;
+#endif
+
+        // Say it's a deletion
+        deletionEdges.insert(edgePointer);
+        
+        if(mode == 'R') {
+            // The reference edges also get marked as such
+            knownEdges.insert(edgePointer);
+#ifdef debug
+            std::cerr << calls.edge_location(i) << ": Edge "
+                << calls.edge_description(i) << " is reference." << endl;
+#endif
+        }
+
+    }
+    
+    if(calls.edgeHasSupport[i]) {
+        // For edges with the number there, actually process the read support
+        Support readSupport = std::make_pair(calls.edgeForwardSupport[i], calls.edgeReverseSupport[i]);
+    
+#ifdef debug
+        std::cerr << calls.edge_location(i) << ": Edge " << calls.edge_description(i)
+            << " has read support " << readSupport.first << "," << readSupport.second << endl;
+#endif
+        
+        // Save it
+        edgeReadSupport[edgePointer] = readSupport;
+        edgeLikelihood[edgePointer] = calls.edgeLikelihoods[i];
+    }
+}
+
+/**
+ * Check a set of Glenn calls against the graph, and load them into the internal
+ * format, where we track status and copy number for nodes and edges.
+ */
+static void load_glenn_calls(const GlennCalls& calls,
+               vg::VG& vg,
+               const EdgeIndex& edges,
+               std::map<vg::Node*, Support>& nodeReadSupport,
+               std::map<vg::Edge*, Support>& edgeReadSupport,
+               std::map<vg::Node*, double>& nodeLikelihood,
+               std::map<vg::Edge*, double>& edgeLikelihood,
+               std::set<vg::Edge*>& deletionEdges,
+               std::map<vg::Node*, std::pair<int64_t, size_t>>& nodeSources,
+               std::set<vg::Node*>& knownNodes,
+               std::set<vg::Edge*>& knownEdges) {
+
+    // Calls built in memory may have any columns, so make sure they line up.
+    size_t nodeCount = calls.nodeIds.size();
+    size_t edgeCount = calls.edgeFroms.size();
+    bool haveLines = !calls.nodeLines.empty() || !calls.edgeLines.empty();
+    if(calls.nodeCallTypes.size() != nodeCount || calls.nodeHasSupport.size() != nodeCount ||
+        calls.nodeForwardSupport.size() != nodeCount || calls.nodeReverseSupport.size() != nodeCount ||
+        calls.nodeOtherSupport.size() != nodeCount || calls.nodeLikelihoods.size() != nodeCount ||
+        calls.nodeOriginalIds.size() != nodeCount || calls.nodeOriginalOffsets.size() != nodeCount ||
+        (haveLines && calls.nodeLines.size() != nodeCount)) {
+        throw std::runtime_error("Node columns have different numbers of records");
+    }
+    if(calls.edgeFromStarts.size() != edgeCount || calls.edgeTos.size() != edgeCount ||
+        calls.edgeToEnds.size() != edgeCount || calls.edgeModes.size() != edgeCount ||
+        calls.edgeHasSupport.size() != edgeCount || calls.edgeForwardSupport.size() != edgeCount ||
+        calls.edgeReverseSupport.size() != edgeCount || calls.edgeOtherSupport.size() != edgeCount ||
+        calls.edgeLikelihoods.size() != edgeCount || (haveLines && calls.edgeLines.size() != edgeCount)) {
+        throw std::runtime_error("Edge columns have different numbers of records");
+    }
+
+    // Go through the node and edge records together, in line order, so that if
+    // more than one is bad we complain about the first. Without line numbers,
+    // do the nodes first.
+    size_t i = 0;
+    size_t j = 0;
+    while(i < nodeCount || j < edgeCount) {
+        if(j == edgeCount || (i < nodeCount && (!haveLines || calls.nodeLines[i] < calls.edgeLines[j]))) {
+            load_glenn_node(calls, i++, vg, nodeReadSupport, nodeLikelihood, nodeSources, knownNodes);
+        } else {
+            load_glenn_edge(calls, j++, edges, edgeReadSupport, edgeLikelihood, deletionEdges, knownEdges);
+        }
+    }
+}
+
+/**
+ * Parse tsv into an internal format, where we track status and copy number
+ * for nodes and edges. Also accepts the binary call format.
+ */
+static void parse_tsv(const std::string& tsvFile,
+               vg::VG& vg,
+               const EdgeIndex& edges,
+               std::map<vg::Node*, Support>& nodeReadSupport,
+               std::map<vg::Edge*, Support>& edgeReadSupport,
+               std::map<vg::Node*, double>& nodeLikelihood,
+               std::map<vg::Edge*, double>& edgeLikelihood,
+               std::set<vg::Edge*>& deletionEdges,
+               std::map<vg::Node*, std::pair<int64_t, size_t>>& nodeSources,
+               std::set<vg::Node*>& knownNodes,
+               std::set<vg::Edge*>& knownEdges) {
+    
+    // Records are read and decompressed on one thread, parsed on several, and
+    // then checked and loaded into the tables here on a single annotator
+    // thread, all at the same time.
+    BoundedQueue<GlennCalls> parsed(4);
+    std::exception_ptr annotateError;
+    std::thread annotator([&]() {
+        GlennCalls batch;
+        while(parsed.pop(batch)) {
+            if(annotateError) {
+                // Just drain the queue so the parser doesn't get stuck.
+                continue;
+            }
+            try {
+                load_glenn_calls(batch, vg, edges, nodeReadSupport, edgeReadSupport, nodeLikelihood,
+                    edgeLikelihood, deletionEdges, nodeSources, knownNodes, knownEdges);
+            } catch(...) {
+                annotateError = std::current_exception();
+            }
+        }
+    });
+    
+    uint64_t lineCount;
+    try {
+        lineCount = read_glenn_file(tsvFile, [&](GlennCalls& batch) {
+            parsed.push(std::move(batch));
+        });
+    } catch(...) {
+        parsed.close();
+        annotator.join();
+        if(annotateError) {
+            // Everything the annotator saw came before the read or parse
+            // error, so report its problem first.
+            std::rethrow_exception(annotateError);
+        }
+        throw;
+    }
+    parsed.close();
+    annotator.join();
+    
+    if(annotateError) {
+        std::rethrow_exception(annotateError);
+    }
+    
+    std::cerr << "Loaded " << lineCount << " lines from " << tsvFile << endl;
+}
+
+/**
+ * Load a sample's pileups from a file of vg Pileup records, so its calls can
+ * be annotated with them.
+ */
+void load_pileups(SampleSupport& sample, const std::string& pileupFilename) {
+    // This will hold pileup records by node ID.
+    auto& nodePileups = sample.nodePileups;
+    std::function<void(vg::Pileup&)> handlePileup = [&](vg::Pileup& p) { 
+        // Handle each pileup chunk
+        for(size_t i = 0; i < p.node_pileups_size(); i++) {
+            // Pull out every node pileup
+            auto& pileup = p.node_pileups(i);
+            // Save the pileup under its node's pointer.
+            nodePileups[pileup.node_id()] = pileup;
+        }
+    };
+    
+    // Pileups are already compressed internally, so only decompress if
+    // they have been gzipped again.
+    ThreadedInputBuffer pileupBuffer(pileupFilename, has_gzip_extension(pileupFilename));
+    if(!pileupBuffer.good()) {
+        throw std::runtime_error("Could not read " + pileupFilename);
+    }
+    std::istream in(&pileupBuffer);
+    pileupBuffer.throw_errors_from(in);
+    stream::for_each(in, handlePileup);
+}
+
+/**
+ * Get which of the given gVCF depth bands a depth falls in. Band 0 is
+ * everything below the lowest band.
+ */
+static size_t gvcf_depth_band(int64_t depth, const std::vector<int64_t>& bands) {
+    return std::upper_bound(bands.begin(), bands.end(), depth) - bands.begin();
+}
+
+/**
+ * Hand the given calls to emit in order by position, with gVCF reference
+ * blocks covering the reference in between them. Blocks come from one sweep
+ * along the reference nodes, alongside the sorted calls. Read support is the
+ * same all along a node, so each sample's depth only changes at node
+ * boundaries, and a block runs over nodes for as long as every sample's depth
+ * stays in the same band.
+ *
+ * droppedIntervals are 0-based, half-open reference intervals where variation
+ * was found but couldn't be called. Blocks over them are kept separate and left
+ * uncalled, instead of claiming the reference there. Calls get a <NON_REF>
+ * allele, as in any gVCF.
+ */
+static void emit_with_reference_blocks(std::vector<std::pair<SiteCall, std::string>>& calls,
+    std::vector<std::pair<size_t, size_t>>& droppedIntervals,
+    const ReferenceIndex& index, const std::vector<SampleSupport>& samples, const CallingOptions& options,
+    const std::function<void(const SiteCall&, const std::string&)>& emit) {
+    
+    std::stable_sort(calls.begin(), calls.end(),
+        [](const std::pair<SiteCall, std::string>& a, const std::pair<SiteCall, std::string>& b) {
+        return a.first.position < b.first.position;
+    });
+    
+    // Sort the dropped intervals and merge any that overlap or touch
+    std::sort(droppedIntervals.begin(), droppedIntervals.end());
+    std::vector<std::pair<size_t, size_t>> dropped;
+    for(auto& interval : droppedIntervals) {
+        if(!dropped.empty() && interval.first <= dropped.back().second) {
+            dropped.back().second = std::max(dropped.back().second, interval.second);
+        } else {
+            dropped.push_back(interval);
+        }
+    }
+    
+    // The block we are building, if any, the band each sample is in, and
+    // whether it covers dropped variation
+    SiteCall block;
+    size_t blockStart = 0;
+    size_t blockPastEnd = 0;
+    std::vector<size_t> blockBands;
+    bool blockDropped = false;
+    
+    /**
+     * Send out the block we are building, if any.
+     */
+    auto finishBlock = [&]() {
+        if(blockPastEnd == blockStart) {
+            return;
+        }
+        
+        block.position = blockStart + 1 + options.variantOffset;
+        block.id = ".";
+        block.end = blockPastEnd + options.variantOffset;
+        block.referenceBlock = true;
+        create_ref_allele(block, char_to_string(index.at(blockStart)));
+        block.alt.push_back("<NON_REF>");
+        block.alleles.push_back("<NON_REF>");
+        for(auto& sample : block.samples) {
+            // Support was added up over the bases, so average it.
+            sample.refSupport = sample.refSupport / (double)(blockPastEnd - blockStart);
+            if(sample.minDepth > 0 && !blockDropped) {
+                sample.set_genotype(0, 0);
+            }
+        }
+        emit(block, "");
+        
+        block = SiteCall();
+        blockStart = blockPastEnd;
+    };
+    
+    // Where are we along the reference, which reference node are we in, and
+    // which dropped interval is next?
+    size_t nextUncovered = 0;
+    auto nodeHere = index.byStart.begin();
+    auto droppedHere = dropped.begin();
+    
+    /**
+     * Cover the reference with blocks from where we are up to the given
+     * position.
+     */
+    auto coverTo = [&](size_t pastEnd) {
+        while(nextUncovered < pastEnd) {
+            // Find the node we are in, and where it ends.
+            auto nextNode = nodeHere;
+            while(nextNode != index.byStart.end() && nextNode->first <= nextUncovered) {
+                nodeHere = nextNode;
+                ++nextNode;
+            }
+            size_t spanPastEnd = std::min(pastEnd,
+                nextNode == index.byStart.end() ? index.size() : nextNode->first);
+            
+            // Stop at the start or end of dropped variation too.
+            while(droppedHere != dropped.end() && droppedHere->second <= nextUncovered) {
+                ++droppedHere;
+            }
+            bool inDropped = droppedHere != dropped.end() && droppedHere->first <= nextUncovered;
+            if(droppedHere != dropped.end()) {
+                spanPastEnd = std::min(spanPastEnd, inDropped ? droppedHere->second : droppedHere->first);
+            }
+            
+            // Get each sample's depth along the node
+            std::vector<Support> supports(samples.size(), std::make_pair(0.0, 0.0));
+            std::vector<size_t> bands(samples.size());
+            for(size_t s = 0; s < samples.size(); s++) {
+                auto found = nodeHere == index.byStart.end() ? samples[s].nodeReadSupport.end() :
+                    samples[s].nodeReadSupport.find(nodeHere->second.node);
+                if(found != samples[s].nodeReadSupport.end()) {
+                    supports[s] = found->second;
+                }
+                bands[s] = gvcf_depth_band(round(total(supports[s])), options.gvcfBands);
+            }
+            
+            if(block.samples.empty() || blockPastEnd != nextUncovered || bands != blockBands ||
+                inDropped != blockDropped) {
+                // This span can't be added to the block we have.
+                finishBlock();
+                blockStart = nextUncovered;
+                blockPastEnd = nextUncovered;
+                blockBands = bands;
+                blockDropped = inDropped;
+                block.samples.assign(samples.size(), SampleCall());
+                for(auto& sample : block.samples) {
+                    sample.minDepth = std::numeric_limits<int64_t>::max();
+                }
+            }
+            
+            for(size_t s = 0; s < samples.size(); s++) {
+                block.samples[s].refSupport += supports[s] * (double)(spanPastEnd - nextUncovered);
+                block.samples[s].minDepth = std::min(block.samples[s].minDepth, (int64_t)round(total(supports[s])));
+            }
+            blockPastEnd = spanPastEnd;
+            nextUncovered = spanPastEnd;
+        }
+        finishBlock();
+    };
+    
+    for(auto& callAndPileups : calls) {
+        SiteCall& call = callAndPileups.first;
+        
+        // Work out where the call is on the reference
+        size_t callStart = call.position - 1 - options.variantOffset;
+        size_t callPastEnd = call.svType.empty() ? callStart + call.ref.size() : call.end - options.variantOffset;
+        
+        coverTo(callStart);
+        call.alt.push_back("<NON_REF>");
+        call.alleles.push_back("<NON_REF>");
+        emit(call, callAndPileups.second);
+        nextUncovered = std::max(nextUncovered, callPastEnd);
+    }
+    coverTo(index.size());
+}
+
+GraphCaller::GraphCaller(vg::VG& graph, const std::string& refPathName, bool packReference,
+    const std::string& refCacheFilename) : graph(graph), refPathName(refPathName) {
+    
+    // Follow the reference path and extract indexes we need: index by node ID,
+    // index by node start, and the reconstructed path sequence. Use the cache
+    // if we have one.
+    referenceIndex.reset(new ReferenceIndex(get_reference_index(graph, refPathName, packReference,
+        refCacheFilename)));
+    
+    // Index the edges so we can find them quickly by the sides they connect.
+    edgeIndex.reset(new EdgeIndex(graph));
+}
+
+GraphCaller::~GraphCaller() {
+    // Nothing to do, but the indexes need to be complete types here.
+}
+
+const std::string& GraphCaller::reference_path_name() const {
+    return refPathName;
+}
+
+void GraphCaller::load_calls(SampleSupport& sample, const std::string& glennFile) const {
+    parse_tsv(glennFile, graph, *edgeIndex, sample.nodeReadSupport, sample.edgeReadSupport,
+              sample.nodeLikelihood, sample.edgeLikelihood, sample.deletionEdges,
+              sample.nodeSources, sample.knownNodes, sample.knownEdges);
+}
+
+void GraphCaller::add_calls(SampleSupport& sample, const GlennCalls& calls) const {
+    load_glenn_calls(calls, graph, *edgeIndex, sample.nodeReadSupport, sample.edgeReadSupport,
+                     sample.nodeLikelihood, sample.edgeLikelihood, sample.deletionEdges,
+                     sample.nodeSources, sample.knownNodes, sample.knownEdges);
+}
+
+void GraphCaller::make_catalog(int64_t maxDepth, const SearchBudget& budget) {
+    catalog.reset(new SiteCatalog(graph, *referenceIndex, maxDepth, budget));
+}
+
+void GraphCaller::save_catalog(std::ostream& out) const {
+    if(!catalog) {
+        throw std::runtime_error("No site catalog to save");
+    }
+    catalog->save(out, graph_topology_checksum(graph), reference_path_checksum(graph, refPathName), refPathName);
+}
+
+void GraphCaller::load_catalog(std::istream& in) {
+    catalog.reset(new SiteCatalog(in, graph, graph_topology_checksum(graph),
+        reference_path_checksum(graph, refPathName), refPathName));
+}
+
+size_t GraphCaller::catalog_size() const {
+    return catalog ? catalog->size() : 0;
+}
+
+std::string GraphCaller::vcf_header(const std::vector<std::string>& sampleNames,
+    const CallingOptions& options) const {
+    
+    // Handle length override if specified.
+    std::string contigName = options.contigName;
+    std::stringstream headerStream;
+    write_vcf_header(headerStream, sampleNames, contigName,
+        options.lengthOverride != -1 ? options.lengthOverride : (referenceIndex->size() + options.variantOffset),
+        options.svThreshold > 0, options.gvcf);
+    return headerStream.str();
+}
+
+// Genotyping one sample at a site is only a few lookups, so only split the
+// samples at a site over threads when there are at least this many of them.
+const static size_t PARALLEL_GENOTYPING_SAMPLES = 16;
+
+void GraphCaller::call(std::vector<SampleSupport>& samples, const CallingOptions& options,
+    const std::function<void(const SiteCall&, const std::string&)>& emit, std::ostream* skippedBed) const {
+    
+    if(samples.empty()) {
+        throw std::runtime_error("No samples to call");
+    }
+    
+    // Unpack the graph and indexes under the names the calling code uses
+    vg::VG& vg = graph;
+    const ReferenceIndex& index = *referenceIndex;
+    const EdgeIndex& edges = *edgeIndex;
+    
+    // And the settings
+    std::string contigName = options.contigName;
+    int64_t variantOffset = options.variantOffset;
+    int64_t maxDepth = options.maxDepth;
+    double minFractionForCall = options.minFractionForCall;
+    double maxHetBias = options.maxHetBias;
+    double maxRefBias = options.maxRefBias;
+    size_t minTotalSupportForCall = options.minTotalSupportForCall;
+    size_t refBinSize = options.refBinSize;
+    size_t expCoverage = options.expCoverage;
+    SearchBudget searchBudget = options.searchBudget;
+    int64_t svThreshold = options.svThreshold;
+    
+    PhaseTimer phaseTimer;
+    phaseTimer.enabled = options.phaseTimes;
+    
+    // In gVCF mode, calls are held until we have them all, so they can be put
+    // in order with the reference blocks between them.
+    std::vector<std::pair<SiteCall, std::string>> heldCalls;
+    // Reference intervals where we found variation but couldn't call it. The
+    // gVCF can't say those are reference.
+    std::vector<std::pair<size_t, size_t>> droppedIntervals;
+    auto dropInterval = [&](size_t start, size_t pastEnd) {
+        if(options.gvcf && start < pastEnd) {
+            droppedIntervals.emplace_back(start, pastEnd);
+        }
+    };
+    std::function<void(const SiteCall&, const std::string&)> holdCall =
+        [&](const SiteCall& call, const std::string& pileupLines) {
+        heldCalls.emplace_back(call, pileupLines);
+    };
+    const std::function<void(const SiteCall&, const std::string&)>& emitCall = options.gvcf ? holdCall : emit;
+    
+    // This holds all the edges that are deletions in any sample
+    std::set<vg::Edge*> deletionEdges;
+    // And where every node came from in the original graph
+    std::map<vg::Node*, std::pair<int64_t, size_t>> nodeSources;
+    // And what edges and nodes are known
+    std::set<vg::Node*> knownNodes;
+    std::set<vg::Edge*> knownEdges;
+    for(auto& sample : samples) {
+        deletionEdges.insert(sample.deletionEdges.begin(), sample.deletionEdges.end());
+        nodeSources.insert(sample.nodeSources.begin(), sample.nodeSources.end());
+        knownNodes.insert(sample.knownNodes.begin(), sample.knownNodes.end());
+        knownEdges.insert(sample.knownEdges.begin(), sample.knownEdges.end());
+    }
+    
+    // Sites are wherever any sample has support, so add up the support over
+    // all the samples. With one sample we can just use its own.
+    std::map<vg::Node*, Support> combinedSupport;
+    if(samples.size() > 1) {
+        for(auto& sample : samples) {
+            for(auto& pointerAndSupport : sample.nodeReadSupport) {
+                combinedSupport[pointerAndSupport.first] += pointerAndSupport.second;
+            }
+        }
+    }
+    const std::map<vg::Node*, Support>& siteSupport = samples.size() > 1 ? combinedSupport : samples.front().nodeReadSupport;
+
+    // Snapshot the graph's connectivity for bubble searching, leaving out the
+    // nodes with no support so we never have to check for them while searching.
+    // If we have a catalog, we may never need to search at all, so wait until
+    // we do.
+    std::unique_ptr<NodeAdjacency> adjacency;
+    auto getAdjacency = [&]() -> const NodeAdjacency& {
+        if(!adjacency) {
+            adjacency.reset(new NodeAdjacency(vg, index, siteSupport));
+        }
+        return *adjacency;
+    };
+    if(catalog == nullptr) {
+        getAdjacency();
+        phaseTimer.finish("adjacency");
+    } else if(catalog->max_depth() != maxDepth) {
+        throw std::runtime_error("Site catalog was made searching " + std::to_string(catalog->max_depth()) +
+            " nodes deep, not " + std::to_string(maxDepth));
+    }
+    
+    /**
+     * Return true if a cataloged bubble only visits nodes with support, so
+     * that searching would find it too.
+     */
+    auto isSupported = [&](const std::vector<vg::NodeTraversal>& bubble) {
+        for(auto& traversal : bubble) {
+            auto found = siteSupport.find(traversal.node);
+            if(found == siteSupport.end() || total(found->second) == 0) {
+                return false;
+            }
+        }
+        return true;
+    };
+    // How many sites could we look up?
+    size_t catalogHits = 0;
+
+    // Store support binned along reference path;
+    // Last bin extended to include remainder
+    refBinSize = min(refBinSize, index.size());
+    
+    for(size_t s = 0; s < samples.size(); s++) {
+        auto& sample = samples[s];
+        auto& binnedSupport = sample.binnedSupport;
+        binnedSupport.assign(max(1, int(index.size() / refBinSize)), Support(expCoverage / 2, expCoverage /2));
+    
+        // Crunch the numbers on the reference and its read support. How much read
+        // support in total (node length * aligned reads) does the primary path get?
+        Support primaryPathTotalSupport = std::make_pair(0.0, 0.0);
+        for(auto& pointerAndSupport : sample.nodeReadSupport) {
+            if(index.byId.count(pointerAndSupport.first->id())) {
+                // This is a primary path node. Add in the total read bases supporting it
+                primaryPathTotalSupport += pointerAndSupport.first->sequence().size() * pointerAndSupport.second;
+                
+                // We also update the total for the appropriate bin
+                if (expCoverage == 0) {
+                    int bin = index.byId.at(pointerAndSupport.first->id()).first / refBinSize;
+                    if (bin == binnedSupport.size()) {
+                        --bin;
+                    }
+                    binnedSupport[bin] = binnedSupport[bin] + 
+                        pointerAndSupport.first->sequence().size() * pointerAndSupport.second;
+                }
+            }
+        }
+        // Calculate average support in reads per base
+        sample.primaryPathAverageSupport = primaryPathTotalSupport / index.size();
+        
+        // Average out the support bins too (in place)
+        int minBin = -1;
+        int maxBin = -1;
+        for (int i = 0; i < binnedSupport.size(); ++i) {
+            if (expCoverage == 0) {
+                binnedSupport[i] = binnedSupport[i] / (
+                    i < binnedSupport.size() - 1 ? (double)refBinSize :
+                    (double)(refBinSize + index.size() % refBinSize));
+            }
+            if (minBin == -1 || binnedSupport[i] < binnedSupport[minBin]) {
+                minBin = i;
+            }
+            if (maxBin == -1 || binnedSupport[i] > binnedSupport[maxBin]) {
+                maxBin = i;
+            }
+        }
+        
+        if(samples.size() > 1) {
+            std::cerr << "Sample " << samples[s].name << ":" << endl;
+        }
+        std::cerr << "Primary path average coverage: " << sample.primaryPathAverageSupport << endl;
+        std::cerr << "Mininimum binned average coverage: " << binnedSupport[minBin] << " (bin "
+                  << (minBin + 1) << " / " << binnedSupport.size() << ")" << endl;
+        std::cerr << "Maxinimum binned average coverage: " << binnedSupport[maxBin] << " (bin "
+                  << (maxBin + 1) << " / " << binnedSupport.size() << ")" << endl;
+    }
+    
+    phaseTimer.finish("coverage");
+    
+    /**
+     * Get the pileup comment lines for a site, for every sample that has
+     * pileups.
+     */
+    auto getPileupLines = [&](const CrossreferenceSet& refCrossreferences, const CrossreferenceSet& altCrossreferences) {
+        std::string lines;
+        for(auto& sample : samples) {
+            lines += get_pileup_line(sample.nodePileups, refCrossreferences, altCrossreferences);
+        }
+        return lines;
+    };
+    
+    // Then go through it from the graph's point of view: first over alt nodes
+    // backending into the reference (creating things occupying ranges to which
+    // we can attribute copy number) and then over reference nodes.
+    
+    // We need to track the bases lost.
+    size_t basesLost = 0;
+    
+    // And the sites we gave up searching for bubbles at.
+    size_t sitesSkipped = 0;
+    
+    // TODO: look at every deletion edge and spit out variants for them.
+    // Complain and maybe remember if they don't connect two primary path nodes.
+    
+    vg.for_each_node([&](vg::Node* node) {
+        // Look at every node in the graph and spit out variants for the ones
+        // that are non-reference, but for which we can push copy number to the
+        // reference path, greedily.
+    
+        // Ensure this node is nonreference
+        if(index.byId.count(node->id())) {
+            // Skip reference nodes
+            return;
+        }
+        
+        // Nodes the call files say nothing about have no support.
+        auto supportFound = siteSupport.find(node);
+        if(supportFound != siteSupport.end() && total(supportFound->second) > 0) {
+            // We have copy number on this node in some sample.
+            
+            // Everything we build for this site comes out of the thread's
+            // arena, which is emptied when we are done with the site.
+            SiteArena::Scope siteScope;
+            
+            // Find a path to the primary reference from here, within our
+            // budget. Look it up in the catalog if we can.
+            searchBudget.start();
+            const std::vector<vg::NodeTraversal>* cataloged = catalog == nullptr ?
+                nullptr : catalog->find(node->id());
+            std::vector<vg::NodeTraversal> path;
+            if(cataloged != nullptr && isSupported(*cataloged)) {
+                path = *cataloged;
+                catalogHits++;
+            } else {
+                path = find_bubble(getAdjacency(), node, index, maxDepth, &searchBudget);
+            }
+            
+            if(path.empty()) {
+                // We couldn't find a path back to the primary path. Discard
+                // this material, and don't call the reference the search
+                // reached, if any.
+                basesLost += node->sequence().size();
+                dropInterval(searchBudget.touchedStart, searchBudget.touchedPastEnd);
+                
+                if(searchBudget.exceeded) {
+                    // We gave up, so say so.
+                    sitesSkipped++;
+                    if(skippedBed != nullptr && searchBudget.touchedStart < searchBudget.touchedPastEnd) {
+                        // Say where we were looking
+                        *skippedBed << (contigName.empty() ? refPathName : contigName) << "\t"
+                            << searchBudget.touchedStart + variantOffset << "\t"
+                            << searchBudget.touchedPastEnd + variantOffset << "\t"
+                            << node->id() << "\n";
+                    }
+                }
+                return;
+            }
+            
+            // Turn it into a substitution/insertion
+            
+            // The position we have stored for this start node is the first
+            // position along the reference at which it occurs. Our bubble
+            // goes forward in the reference, so we must come out of the
+            // opposite end of the node from the one we have stored.
+            auto referenceIntervalStart = index.byId.at(path.front().node->id()).first +
+                path.front().node->sequence().size();
+            
+            // The position we have stored for the end node is the first
+            // position it occurs in the reference, and we know we go into
+            // it in a reference-concordant direction, so we must have our
+            // past-the-end position right there.
+            auto referenceIntervalPastEnd = index.byId.at(path.back().node->id()).first;
+            
+            // We'll fill in this string with all the node sequences we visit on
+            // the path, except for the first and last.
+            std::string altAllele;
+            
+            
+            // Is this a pure insert, with a base added before it?
+            bool paddedInsert = false;
+            if(referenceIntervalPastEnd - referenceIntervalStart == 0) {
+                // If this is an insert, make sure we have the 1 base before it.
+                
+                // TODO: we should handle an insert at the very beginning
+                assert(referenceIntervalStart > 0);
+                
+                // Budge left and add that character to the alt as well
+                referenceIntervalStart--;
+                altAllele.push_back(index.at(referenceIntervalStart));
+                paddedInsert = true;
+            }
+            
+            // Variants should be reference if most of their bases are
+            // reference, and novel otherwise. A single SNP base on a known
+            // insert should not make it a novel insert.
+            size_t knownAltBases = 0;
+            
+            // How many alt bases are there overall, both known and novel?
+            size_t altBases = 0;
+            
+            // We also need a list of all the alt node IDs for naming the
+            // variant.
+            std::string variantId;
+            
+            // And collections of all the involved node pointers, on both the
+            // ref and alt sides
+            SiteSet<vg::Node*> refInvolvedNodes;
+            SiteSet<vg::Node*> altInvolvedNodes;
+            
+            for(int64_t i = 1; i < path.size() - 1; i++) {
+                // For all but the first and last nodes, grab their sequences in
+                // the correct orientation.
+                
+                const std::string& nodeSequence = path[i].node->sequence();
+            
+                if(path[i].backward) {
+                    // If the node is traversed backward, we need to stick on
+                    // its sequence flipped.
+                    size_t oldSize = altAllele.size();
+                    altAllele.resize(oldSize + nodeSequence.size());
+                    reverse_complement_into(nodeSequence.data(), nodeSequence.size(), &altAllele[oldSize]);
+                } else {
+                    // Stick the sequence
+                    altAllele += nodeSequence;
+                }
+                
+                // Record ID
+                variantId += std::to_string(path[i].node->id());
+                if(i != path.size() - 2) {
+                    // Add a separator (-2 since the last thing is path is an
+                    // anchoring reference node)
+                    variantId += "_";
+                }
+                
+                // Record involvement
+                altInvolvedNodes.insert(path[i].node);
+                    
+                if(knownNodes.count(path[i].node)) {
+                    // This is a reference node.
+                    knownAltBases += path[i].node->sequence().size();
+                }
+                // We always need to add in the length of the node to the total
+                // length
+                altBases += path[i].node->sequence().size();
+            }
+
+
+            // Find the primary path nodes that are being skipped over/bypassed
+            
+            // First collect all the IDs of nodes we aren't skipping because
+            // they're in the alt. Don't count those.
+            SiteSet<int64_t> altIds;
+            for(auto& visit : path) {
+                altIds.insert(visit.node->id());
+            }
+
+            // Holds the primary path nodes the alt replaces, in order.
+            SiteVector<vg::Node*> refNodes;
+            // And total bases of material we looked at on the primary path and
+            // not this alt
+            size_t refBases = 0;
+            int64_t refNodeStart = referenceIntervalStart;
+            
+            while(refNodeStart < referenceIntervalPastEnd) {
+            
+                // Find the reference node starting here or later. Remember that
+                // a variant anchored at its left base to a reference position
+                // may have no node starting right where it starts.
+                auto found = index.byStart.lower_bound(refNodeStart);
+                if(found == index.byStart.end()) {
+                    // No reference nodes here! That's a bit weird. But stop the
+                    // loop.
+                    break;
+                }
+                if((*found).first >= referenceIntervalPastEnd) {
+                    // The next reference node we can find is out of the space
+                    // being replaced. We're done.
+                    break;
+                }
+                
+                // Pull out the reference node we located
+                auto* refNode = (*found).second.node;
+                
+                // Record involvement
+                refInvolvedNodes.insert(refNode);
+            
+                // Next iteration look where this node ends.
+                refNodeStart = (*found).first + refNode->sequence().size();
+            
+                if(altIds.count(refNode->id())) {
+                    // This node is also involved in the alt we did take, so
+                    // skip it. TODO: work out how to deal with shared nodes.
+#ifdef debug
+                    std::cerr << "Node " << refNode->id() << " also used in alt" << std::endl;
+#endif
+                    continue;
+                }
+                
+                // Say we saw these bases, which may or may not have been called present
+                refBases += refNode->sequence().size();
+                refNodes.push_back(refNode);
+            }
+            
+            // If there's no reference node, we're a pure insert. Like with
+            // deletions, we should look at the edge that bypasses us to see if
+            // there's any support for it. We want an edge from the end of the
+            // node before us to the start of the node after us.
+            vg::Edge* bypass = refBases != 0 ? nullptr : edges.find(std::make_pair(
+                vg::NodeSide(path.front().node->id(), true),
+                vg::NodeSide(path.back().node->id())));
+            
+            // Now work out how each sample supports the alleles. Samples are
+            // independent, so with enough of them do them all at once.
+            std::vector<SampleCall> sampleCalls(samples.size());
+#pragma omp parallel for if(samples.size() >= PARALLEL_GENOTYPING_SAMPLES)
+            for(size_t s = 0; s < samples.size(); s++) {
+                auto& sample = samples[s];
+                auto& sampleCall = sampleCalls[s];
+                auto& nodeReadSupport = sample.nodeReadSupport;
+                auto& nodeLikelihood = sample.nodeLikelihood;
+                
+                // We want to know how much read support in total the alt has
+                // (support * node length)
+                Support altReadSupportTotal = std::make_pair(0.0, 0.0);
+                
+                // And we keep track of the ref and alt nodes with the lowest likelihoods
+                // (for insertion, we use the bypass edge for the ref likelihood)
+                std::pair<vg::Node*, double> altMinLikelihood(nullptr, LOG_ZERO);
+                std::pair<vg::Node*, double> refMinLikelihood(nullptr, LOG_ZERO);
+                
+                for(int64_t i = 1; i < path.size() - 1; i++) {
+                    if(nodeReadSupport.count(path[i].node)) {
+                        // We have read support for this node. Add it in to the total support for the alt.
+                        altReadSupportTotal += path[i].node->sequence().size() * nodeReadSupport.at(path[i].node);
+                    }
+                    
+                    // Update minimum likelihood in the alt path
+                    if(nodeLikelihood.count(path[i].node)) {
+                        double likelihood = nodeLikelihood.at(path[i].node);
+                        if (altMinLikelihood.first == nullptr || likelihood < altMinLikelihood.second) {
+                            altMinLikelihood = make_pair(path[i].node, likelihood);
+                        }
+                    }
+                }
+                
+                // Holds total primary path base readings observed (read support * node length).
+                Support refReadSupportTotal = std::make_pair(0.0, 0.0);
+                for(auto* refNode : refNodes) {
+#ifdef debug
+                    std::cerr << "Node " << refNode->id() << " has " << nodeReadSupport.at(refNode) << " copies" << std::endl;
+#endif
+                    
+                    if(nodeReadSupport.count(refNode)) {
+                        // Count the bases we see not deleted
+                        refReadSupportTotal += refNode->sequence().size() * nodeReadSupport.at(refNode);
+                    }
+                    
+                    // Update minimum likelihood in the ref path
+                    if(nodeLikelihood.count(refNode)) {
+                        double likelihood = nodeLikelihood.at(refNode);
+                        if (refMinLikelihood.first == nullptr || likelihood < refMinLikelihood.second) {
+                            refMinLikelihood = make_pair(refNode, likelihood);
+                        }
+                    }
+                }
+                
+#ifdef debug
+                std::cerr << variantId << " ref alternative: " << refReadSupportTotal << "/" << refBases
+                    << " from " << referenceIntervalStart << " to " << referenceIntervalPastEnd << std::endl;
+#endif
+                
+                // We divide the read support of stuff passed over by the total
+                // bases of stuff passed over to get the average read support for
+                // the primary path allele.
+                Support refReadSupportAverage = refBases == 0 ? std::make_pair(0.0, 0.0) : refReadSupportTotal / refBases;
+                
+                // And similarly for the alt
+                Support altReadSupportAverage = altBases == 0 ? std::make_pair(0.0, 0.0) : altReadSupportTotal / altBases;
+                
+                if(bypass != nullptr) {
+                    // Any reads supporting the edge bypassing the insert are
+                    // really ref support reads, and should count as supporting
+                    // the whole ref allele.
+                    refReadSupportTotal = sample.edgeReadSupport.count(bypass) ? sample.edgeReadSupport.at(bypass) : std::make_pair(0.0, 0.0); 
+                    refReadSupportAverage = refReadSupportTotal;
+                    
+                    // set minimum likelihood in the ref path using the edge
+                    if(sample.edgeLikelihood.count(bypass)) {
+                        double likelihood = sample.edgeLikelihood.at(bypass);
+                        assert(refMinLikelihood.first == nullptr);
+                        refMinLikelihood = make_pair(nullptr, likelihood);
+                    }
+                }
+                // Otherwise if there's no edge or no support for that edge, the ref support should stay 0.
+                
+                // We're going to make some really bad calls at low depth. We can
+                // pull them out with a depth filter, but for now just elide them.
+                // Call the alt allele 1 for now.
+                if(total(refReadSupportAverage + altReadSupportAverage) >= total(sample.primaryPathAverageSupport) * minFractionForCall) {
+                    if(total(refReadSupportAverage) > maxRefBias * total(altReadSupportAverage) &&
+                        total(refReadSupportTotal) >= minTotalSupportForCall) {
+                        // Biased enough towards ref, and ref has enough total reads.
+                        // Say it's hom ref
+                        sampleCall.set_genotype(0, 0);
+                    } else if(total(altReadSupportAverage) > maxHetBias * total(refReadSupportAverage)
+                        && total(altReadSupportTotal) >= minTotalSupportForCall) {
+                        // Say it's hom alt
+                        sampleCall.set_genotype(1, 1);
+                    } else if(total(refReadSupportTotal) >= minTotalSupportForCall &&
+                        total(altReadSupportTotal) >= minTotalSupportForCall) {
+                        // Say it's het
+                        sampleCall.set_genotype(0, 1);
+                    } else {
+                        // We can't really call this as anything.
+                        sampleCall.set_genotype(-1, -1);
+                    }
+                } else {
+                    // Depth too low. Say we have no idea.
+                    // TODO: elide variant?
+                    sampleCall.set_genotype(-1, -1);
+                }
+                // TODO: use legit thresholds here.
+                
+                // Record the allele supports and likelihoods (from minimum values
+                // found on their paths)
+                sampleCall.refSupport = refReadSupportAverage;
+                sampleCall.altSupport = altReadSupportAverage;
+                sampleCall.refLikelihood = refMinLikelihood.second;
+                sampleCall.altLikelihood = altMinLikelihood.second;
+            }
+            
+            // How much longer or shorter than the ref is the alt?
+            int64_t svLength = (int64_t)altAllele.size() - (int64_t)(referenceIntervalPastEnd - referenceIntervalStart);
+            
+            // Big length changes get symbolic alleles, but only if they are pure
+            // deletions or insertions, which lose nothing when written as a
+            // padding base and a length. Replacements keep their sequence.
+            // Inserts already have their padding base, and so does anything
+            // where one allele is just the first base of the other. Pure
+            // deletions need the base before them.
+            size_t refLength = referenceIntervalPastEnd - referenceIntervalStart;
+            bool anchored = paddedInsert ||
+                (altAllele.size() == 1 && refLength > 1 && index.at(referenceIntervalStart) == altAllele[0]) ||
+                (refLength == 1 && altAllele.size() > 1 && index.at(referenceIntervalStart) == altAllele[0]);
+            bool pureDeletion = altAllele.empty() && referenceIntervalStart > 0;
+            bool symbolic = svThreshold > 0 && std::abs(svLength) > svThreshold && (anchored || pureDeletion);
+            
+            // Where does the ref allele start?
+            size_t refAlleleStart = (symbolic && pureDeletion) ? referenceIntervalStart - 1 : referenceIntervalStart;
+            
+            // Make the variant and emit it. Symbolic alleles only need the
+            // padding base from the reference.
+            std::string refAllele = symbolic ? index.substr(refAlleleStart, 1) : index.substr(
+                referenceIntervalStart, referenceIntervalPastEnd - referenceIntervalStart);
+            
+            // Make a call
+            SiteCall call;
+            call.position = refAlleleStart + 1 + variantOffset;
+            call.id = variantId;
+            
+            // Flag the variant as reference if most of its alt is known
+            call.known = knownAltBases > 0 && knownAltBases >= altBases / 2;
+            
+            // We need to deduplicate the corss-references, because multiple
+            // involved nodes may cross-reference the same original node and
+            // offset, and because the same original node and offset can be
+            // referenced by both ref and alt paths.
+            CrossreferenceSet refCrossreferences;
+            CrossreferenceSet altCrossreferences;
+            CrossreferenceSet crossreferences;
+            
+            for(auto* node : refInvolvedNodes) {
+                // Every involved node gets its original node:offset recorded as
+                // an XSEE cross-reference.
+                
+                if(nodeSources.count(node)) {
+                    // It has a source. Find it
+                    auto& source = nodeSources.at(node);
+                    // Then add it to be referenced.
+                    refCrossreferences.insert(source);
+                    crossreferences.insert(source);
+                }
+            }
+            for(auto* node : altInvolvedNodes) {
+                // Every involved node gets its original node:offset recorded as
+                // an XSEE cross-reference.
+                
+                if(nodeSources.count(node)) {
+                    // It has a source. Find it
+                    auto& source = nodeSources.at(node);
+                    // Then add it to be referenced.
+                    altCrossreferences.insert(source);
+                    crossreferences.insert(source);
+                }
+            }
+            call.crossreferences.assign(crossreferences.begin(), crossreferences.end());
+            
+            // Initialize the ref allele
+            create_ref_allele(call, refAllele);
+            
+            // Add the alt allele
+            int altNumber = symbolic ?
+                add_symbolic_allele(call, svLength < 0 ? "DEL" : "INS", referenceIntervalPastEnd + variantOffset, svLength) :
+                add_alt_allele(call, altAllele);
+            
+            // The samples were genotyped as if the alt were allele 1, but it
+            // may have turned out to be the same as the ref.
+            for(auto& sampleCall : sampleCalls) {
+                for(auto& allele : sampleCall.genotype) {
+                    if(allele == 1) {
+                        allele = altNumber;
+                    }
+                }
+            }
+            
+            // Quick quality: combine likelihood and depth, using poisson for
+            // latter. The site gets the best quality of any sample.
+            call.samples = std::move(sampleCalls);
+            for(size_t s = 0; s < samples.size(); s++) {
+                auto& binnedSupport = samples[s].binnedSupport;
+                int bin = referenceIntervalStart / refBinSize;
+                if (bin == binnedSupport.size()) {
+                    --bin;
+                }
+                call.samples[s].quality = call_quality(call.samples[s], binnedSupport[bin]);
+                if(s == 0 || call.samples[s].quality > call.quality) {
+                    call.quality = call.samples[s].quality;
+                }
+            }
+            
+            
+#ifdef debug
+            std::cerr << "Found variant " << refAllele << " -> " << altAllele
+                << " caused by nodes " <<  call.id
+                << " at 1-based reference position " << call.position
+                << std::endl;
+#endif
+
+            if(can_write_alleles(call)) {
+                if(options.normalize) {
+                    // Trim and left-align the alleles before they go out.
+                    normalize_call(call, index, variantOffset);
+                }
+                
+                // Output the created call, with the pileup line, which will
+                // be nonempty if we have pileups
+                emitCall(call, getPileupLines(refCrossreferences, altCrossreferences));
+            
+            } else {
+                std::cerr << "Variant is too large" << std::endl;
+                // TODO: account for the 1 base we added extra if it was a pure
+                // insert.
+                basesLost += altAllele.size();
+                dropInterval(referenceIntervalStart, std::max(referenceIntervalPastEnd, referenceIntervalStart + 1));
+            }
+            
+            
+        }
+        
+        
+    });
+    phaseTimer.finish("node_sites");
+    if(catalog != nullptr) {
+        std::cerr << "Looked up " << catalogHits << " sites in the site catalog" << std::endl;
+    }
+    
+    for(vg::Edge* deletion : deletionEdges) {
+        // Make deletion variants for each deletion edge
+        
+        // Make a string naming the edge
+        std::string edgeName = std::to_string(deletion->from()) +
+            (deletion->from_start() ? "L" : "R") + "->" +
+            std::to_string(deletion->to()) + (deletion->to_end() ? "R" : "L");
+        
+        if(!index.byId.count(deletion->from()) || !index.byId.count(deletion->to())) {
+            // This deletion edge does not cover a reference interval.
+            // TODO: take into account its presence when pushing copy number.
+#ifdef debug
+            std::cerr << "Deletion edge " << edgeName << " does not cover a reference interval. Skipping!" << endl;
+#endif
+            continue;
+        }
+        
+        // Where are we from and to in the reference (leftmost position and
+        // relative orientation)
+        auto& fromPlacement = index.byId.at(deletion->from());
+        auto& toPlacement = index.byId.at(deletion->to());
+        
+#ifdef debug
+        std::cerr << "Node " << deletion->from() << " is at ref position " 
+            << fromPlacement.first << " orientation " << fromPlacement.second << std::endl;
+        std::cerr << "Node " << deletion->to() << " is at ref position "
+            << toPlacement.first << " orientation " << toPlacement.second << std::endl;
+#endif
+        
+        // Are we attached to the reference-relative left or right of our from
+        // base?
+        bool fromFirst = fromPlacement.second != deletion->from_start();
+        
+        // And our to base?
+        bool toLast = toPlacement.second != deletion->to_end();
+        
+        // What base should the from end really be on? This is the non-deleted
+        // base outside the deletion on the from end.
+        int64_t fromBase = fromPlacement.first + (fromFirst ? 0 : vg.get_node(deletion->from())->sequence().size() - 1);
+        
+        // And the to end?
+        int64_t toBase = toPlacement.first + (toLast ? vg.get_node(deletion->to())->sequence().size() - 1 : 0);
+
+        if(toBase <= fromBase) {
+            // Our edge ought to be running backward.
+            if(!(fromFirst && toLast)) {
+                // We're not a proper deletion edge in the backwards spelling
+                // Discard the edge
+                std::cerr << "Improper deletion edge " << edgeName << std::endl;
+                basesLost += toBase - fromBase;
+                dropInterval(toBase, fromBase + 1);
+                continue;
+            } else {
+                // Just invert the from and to bases.
+                std::swap(fromBase, toBase);
+#ifdef debug
+                std::cerr << "Inverted deletion edge " << edgeName << std::endl;
+#endif
+            }
+        } else if(fromFirst || toLast) {
+            // We aren't a proper deletion edge in the forward spelling either.
+            std::cerr << "Improper deletion edge " << edgeName << std::endl;
+            basesLost += fromBase - toBase;
+            dropInterval(fromBase, toBase + 1);
+            continue;
+        }
+        
+        
+        if(toBase <= fromBase + 1) {
+            // No bases were actually deleted. Maybe this is just a normal reference edge.
+            continue;
+        }
+        
+#ifdef debug
+        std::cerr << "Deletion " << edgeName << " bookended by " << fromBase << " and " << toBase << std::endl;
+#endif
+        
+        // Everything we build for this site comes out of the thread's arena,
+        // which is emptied when we are done with the site.
+        SiteArena::Scope siteScope;
+        
+        // What original node:offset places do we care about?
+        CrossreferenceSet crossreferences;
+        
+        // Which reference nodes are deleted?
+        SiteVector<vg::Node*> deletedNodes;
+        
+        int64_t deletedNodeStart = fromBase + 1;
+        while(deletedNodeStart != toBase) {
+#ifdef debug
+            std::cerr << "Next deleted node starts at " << deletedNodeStart << std::endl;
+#endif
+        
+            // Find the deleted node starting here in the reference
+            auto* deletedNode = index.byStart.at(deletedNodeStart).node;
+            // We know the next reference node should start just after this one.
+            // Even if it previously existed in the reference.
+            deletedNodeStart += deletedNode->sequence().size();
+            deletedNodes.push_back(deletedNode);
+            
+            if(nodeSources.count(deletedNode)) {
+                // Add the beginning of this node as a see also. The deletion is
+                // stored at the beginning of the first node, and the other
+                // locations will help us get an idea of how much support the
+                // deleted stuff has.
+                crossreferences.insert(nodeSources.at(deletedNode));
+            }
+        }
+        
+        // Guess the copy number of the deletion in each sample: 0 if it isn't
+        // there, or -1 if we can't tell. Samples are independent, like above.
+        std::vector<SampleCall> sampleCalls(samples.size());
+        std::vector<int64_t> copyNumberCalls(samples.size(), 2);
+#pragma omp parallel for if(samples.size() >= PARALLEL_GENOTYPING_SAMPLES)
+        for(size_t s = 0; s < samples.size(); s++) {
+            auto& sample = samples[s];
+            
+            // Holds total base copies (node length * read support) observed as not deleted.
+            Support refReadSupportTotal = std::make_pair(0.0, 0.0);
+            std::pair<vg::Node*, double> refMinLikelihood(NULL, LOG_ZERO);
+            
+            for(auto* deletedNode : deletedNodes) {
+                // Nodes the call file says nothing about have no support.
+                if(!sample.nodeReadSupport.count(deletedNode)) {
+                    continue;
+                }
+                
+                // Count the read observations we see not deleted
+                refReadSupportTotal += deletedNode->sequence().size() * sample.nodeReadSupport.at(deletedNode);
+                
+                // Update minimum node likelihood
+                double likelihood = sample.nodeLikelihood.at(deletedNode);
+                if (refMinLikelihood.first == NULL || likelihood < refMinLikelihood.second) {
+                    refMinLikelihood = make_pair(deletedNode, likelihood);
+                }
+            }
+            
+            // We divide the total read support by the total bases deleted to get
+            // the average read support for the reference.
+            Support refReadSupportAverage = refReadSupportTotal / (toBase - fromBase - 1);
+            
+            // Get the support for the edge itself?
+            Support altReadSupportTotal = sample.edgeReadSupport.count(deletion) ? sample.edgeReadSupport.at(deletion) : std::make_pair(0.0, 0.0);
+            double altMinLikelihood = sample.edgeLikelihood.count(deletion) ? sample.edgeLikelihood.at(deletion) : LOG_ZERO;
+            // No sense averaging the deletion edge read support because there are no bases.
+            
+            // What copy number do we call for the deletion?
+            int64_t& copyNumberCall = copyNumberCalls[s];
+            
+            // We're going to make some really bad calls at low depth. We can
+            // pull them out with a depth filter, but for now just elide them.
+            if(total(refReadSupportAverage + altReadSupportTotal) >= total(sample.primaryPathAverageSupport) * minFractionForCall) {
+                if(total(refReadSupportAverage) > maxRefBias * total(altReadSupportTotal) &&
+                    total(refReadSupportTotal) >= minTotalSupportForCall) {
+                    // Say it's hom ref
+                    copyNumberCall = 0;
+                } else if(total(altReadSupportTotal) > maxHetBias * total(refReadSupportAverage) &&
+                    total(altReadSupportTotal) >= minTotalSupportForCall) {
+                    // Say it's hom alt
+                    copyNumberCall = 2;
+                } else if(total(refReadSupportTotal) >= minTotalSupportForCall &&
+                    total(altReadSupportTotal) >= minTotalSupportForCall) {
+                    // Say it's het
+                    copyNumberCall = 1;
+                } else {
+                    // We're not biased enough towards either homozygote, but we
+                    // don't have enough support for each allele to call het.
+                    // TODO: we just don't call
+                    copyNumberCall = -1;
+                }
+            } else {
+                // Depth too low. Don't call.
+                copyNumberCall = -1;
+            }
+            // TODO: use legit thresholds here.
+            
+            // Record the allele supports and likelihoods (from minimum values found
+            // on their paths). No sense averaging the deletion edge read support
+            // because there are no bases.
+            sampleCalls[s].refSupport = refReadSupportAverage;
+            sampleCalls[s].altSupport = altReadSupportTotal;
+            sampleCalls[s].refLikelihood = refMinLikelihood.second;
+            sampleCalls[s].altLikelihood = altMinLikelihood;
+        }
+        
+        if(*std::max_element(copyNumberCalls.begin(), copyNumberCalls.end()) <= 0) {
+            // Actually don't call a deletion, since no sample has it
+            continue;
+        }
+        
+        // Now we know fromBase is the last non-deleted base and toBase is the
+        // first non-deleted base. We'll make an alt replacing the first non-
+        // deleted base plus the deletion with just the first non-deleted base.
+        // Rename everything to the same names we were using before.
+        size_t referenceIntervalStart = fromBase;
+        size_t referenceIntervalPastEnd = toBase;
+        
+        // Big deletions get a symbolic allele, so we don't need to pull out
+        // all the deleted sequence.
+        int64_t svLength = -(int64_t)(referenceIntervalPastEnd - referenceIntervalStart - 1);
+        bool symbolic = svThreshold > 0 && -svLength > svThreshold;
+        
+        // Make the variant and emit it.
+        std::string refAllele = index.substr(
+            referenceIntervalStart, symbolic ? 1 : referenceIntervalPastEnd - referenceIntervalStart);
+        std::string altAllele = index.substr(referenceIntervalStart, 1);
+        
+        // Make a call
+        SiteCall call;
+        call.position = referenceIntervalStart + 1 + variantOffset;
+        call.id = edgeName;
+        
+        if(knownEdges.count(deletion)) {
+            // Mark it as reference if it is a reference edge.
+            call.known = true;
+#ifdef debug
+            std::cerr << edgeName << " is a reference deletion" << std::endl;
+#endif
+        }
+        
+        // Add in all the deduplicated cross-references
+        call.crossreferences.assign(crossreferences.begin(), crossreferences.end());
+        
+        // Initialize the ref allele
+        create_ref_allele(call, refAllele);
+        
+        // Add the alt allele
+        int altNumber = symbolic ?
+            add_symbolic_allele(call, "DEL", referenceIntervalPastEnd + variantOffset, svLength) :
+            add_alt_allele(call, altAllele);
+        
+        call.samples = std::move(sampleCalls);
+        for(size_t s = 0; s < samples.size(); s++) {
+            auto& sampleCall = call.samples[s];
+            if(copyNumberCalls[s] == -1) {
+                // We can't tell
+                sampleCall.set_genotype(-1, -1);
+            } else if(copyNumberCalls[s] == 0) {
+                // We don't have the deletion.
+                sampleCall.set_genotype(0, 0);
+            } else if(copyNumberCalls[s] == 1) {
+                // We're allele alt and ref heterozygous.
+                sampleCall.set_genotype(0, altNumber);
+            } else if(copyNumberCalls[s] == 2) {
+                // We're alt homozygous, other overlapping variants notwithstanding.
+                sampleCall.set_genotype(altNumber, altNumber);
+            } else {
+                // We're something weird
+                throw std::runtime_error("Invalid copy number for deletion: " + std::to_string(copyNumberCalls[s]));
+            }
+            
+            // Quick quality: combine likelihood and depth, using poisson for
+            // latter. The site gets the best quality of any sample.
+            auto& binnedSupport = samples[s].binnedSupport;
+            int bin = referenceIntervalStart / refBinSize;
+            if (bin == binnedSupport.size()) {
+                --bin;
+            }
+            sampleCall.quality = call_quality(sampleCall, binnedSupport[bin]);
+            if(s == 0 || sampleCall.quality > call.quality) {
+                call.quality = sampleCall.quality;
+            }
+        }
+        
+#ifdef debug
+        std::cerr << "Found variant " << refAllele << " -> " << altAllele
+            << " caused by edge " <<  call.id
+            << " at 1-based reference position " << call.position
+            << std::endl;
+#endif
+
+        if(can_write_alleles(call)) {
+            if(options.normalize) {
+                // Trim and left-align the alleles before they go out.
+                normalize_call(call, index, variantOffset);
+            }
+            
+            // Output the created call, with the pileup line, which will be
+            // nonempty if we have pileups. We only have ref crossreferences
+            // here. TODO: make the ref and alt labels make sense for
+            // deletions/re-design the way labeling works.
+            emitCall(call, getPileupLines(crossreferences, CrossreferenceSet()));
+            
+        } else {
+            std::cerr << "Variant is too large" << std::endl;
+            // TODO: Drop the anchoring base that doesn't really belong to the
+            // deletion, when we can be consistent with inserts.
+            basesLost += altAllele.size();
+            dropInterval(referenceIntervalStart, referenceIntervalPastEnd);
+        }
+        
+    }
+    
+    phaseTimer.finish("deletion_sites");
+    
+    if(options.gvcf) {
+        emit_with_reference_blocks(heldCalls, droppedIntervals, index, samples, options, emit);
+        phaseTimer.finish("reference_blocks");
+    }
+    
+    // Announce how much we can't show.
+    std::cerr << "Had to drop " << basesLost << " bp of unrepresentable variation." << std::endl;
+    if(sitesSkipped > 0) {
+        std::cerr << "Gave up searching for bubbles at " << sitesSkipped
+            << " sites that exceeded the search budget." << std::endl;
+    }
+}
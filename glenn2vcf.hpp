@@ -0,0 +1,685 @@
+// glenn2vcf.hpp: Library interface for turning Glenn-format calls against a
+// vg graph into VCF records
+
+#ifndef GLENN2VCF_HPP
+#define GLENN2VCF_HPP
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <utility>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <cstdint>
+#include <cstdio>
+#include <cmath>
+
+#include "ekg/vg/src/vg.hpp"
+#include "ekg/vg/deps/vcflib/src/Variant.h"
+#include "htslib/vcf.h"
+
+/*
+ * The calling pipeline can be used in-process, without going through files,
+ * as well as from the command line tool:
+ *
+ * - Make a GraphCaller for a loaded graph and its reference path. This builds
+ *   the reference and edge indexes once; the graph must outlive it.
+ * - Fill in a SampleSupport for each sample, from a Glenn file with
+ *   load_calls() or from calls already in memory with add_calls().
+ * - Call call() with a callback, which is handed each SiteCall as it is made,
+ *   in the order the VCF would have them. Turn them into vcflib Variants with
+ *   to_variant(), or hand them to a CallWriter to write VCF or BCF.
+ *
+ * Calling never modifies the GraphCaller, so several samples can be called
+ * against the same one at once from different threads.
+ */
+
+// Minimum log likelihood
+const static double LOG_ZERO = (double)-1e100;
+
+// We represent support as a pair, but we define math for it.
+// We use doubles because we may need fractional math.
+typedef std::pair<double, double> Support;
+
+/**
+ * Add two Support values together, accounting for strand.
+ */
+inline Support operator+(const Support& one, const Support& other) {
+    return std::make_pair(one.first + other.first, one.second + other.second);
+}
+
+/**
+ * Add in a Support to another.
+ */
+inline Support& operator+=(Support& one, const Support& other) {
+    one.first += other.first;
+    one.second += other.second;
+    return one;
+}
+
+
+/**
+ * Scale a support by a factor.
+ */
+template<typename Scalar>
+Support operator*(const Support& support, const Scalar& scale) {
+    return std::make_pair(support.first * scale, support.second * scale);
+}
+
+/**
+ * Scale a support by a factor, the other way
+ */
+template<typename Scalar>
+Support operator*(const Scalar& scale, const Support& support) {
+    return std::make_pair(support.first * scale, support.second * scale);
+}
+
+/**
+ * Divide a support by a factor.
+ */
+template<typename Scalar>
+Support operator/(const Support& support, const Scalar& scale) {
+    return std::make_pair(support.first / scale, support.second / scale);
+}
+    
+/**
+ * Allow printing a support.
+ */
+inline std::ostream& operator<<(std::ostream& stream, const Support& support) {
+    return stream << support.first << "," << support.second;
+}
+
+/**
+ * Get the total read support in a support.
+ */
+inline double total(const Support& support) {
+    return support.first + support.second;
+}
+
+/**
+ * Get the strand bias of a support.
+ */
+inline double strand_bias(const Support& support) {
+    return std::max(support.first, support.second) / (support.first + support.second);
+}
+
+/**
+ * Limits on how much work one bubble search may do, and a record of how much
+ * it has done so far. A limit of 0 means no limit. Also tracks the reference
+ * interval the search has reached, so sites we give up on can be reported.
+ */
+struct SearchBudget {
+    // How many search steps may be expanded, on both sides together?
+    size_t maxExpansions = 0;
+    // How many seconds may the search take?
+    double maxSeconds = 0;
+    
+    // How many steps have we expanded?
+    size_t expansions = 0;
+    // When did the search start?
+    std::chrono::steady_clock::time_point started;
+    // Did we run out?
+    bool exceeded = false;
+    
+    // What reference interval have we reached? Empty if we haven't reached
+    // the reference.
+    size_t touchedStart = (size_t)-1;
+    size_t touchedPastEnd = 0;
+    
+    /**
+     * Reset for a new search.
+     */
+    void start() {
+        expansions = 0;
+        exceeded = false;
+        touchedStart = (size_t)-1;
+        touchedPastEnd = 0;
+        if(maxSeconds > 0) {
+            started = std::chrono::steady_clock::now();
+        }
+    }
+    
+    /**
+     * Pay for one expansion. Returns false if we are out of budget.
+     */
+    bool spend() {
+        expansions++;
+        if(maxExpansions > 0 && expansions > maxExpansions) {
+            exceeded = true;
+        } else if(maxSeconds > 0 && expansions % 256 == 0) {
+            // Only look at the clock every so often.
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - started;
+            if(elapsed.count() > maxSeconds) {
+                exceeded = true;
+            }
+        }
+        return !exceeded;
+    }
+    
+    /**
+     * Note that the search reached the given reference interval.
+     */
+    void touch(size_t start, size_t length) {
+        touchedStart = std::min(touchedStart, start);
+        touchedPastEnd = std::max(touchedPastEnd, start + length);
+    }
+};
+
+/**
+ * Times the phases of a run, one after the other, and reports each one on
+ * standard error as it finishes, if enabled.
+ */
+struct PhaseTimer {
+    // Should we actually report anything?
+    bool enabled = false;
+    // When did the current phase start?
+    std::chrono::steady_clock::time_point started = std::chrono::steady_clock::now();
+    
+    /**
+     * Say the current phase, with the given name, is done, and start the next
+     * one.
+     */
+    void finish(const std::string& phase) {
+        auto now = std::chrono::steady_clock::now();
+        if(enabled) {
+            std::cerr << "Phase " << phase << " took "
+                << std::chrono::duration<double>(now - started).count() << " seconds." << std::endl;
+        }
+        started = now;
+    }
+};
+
+/**
+ * Holds the records from a Glenn call file, stored by column, so they can be
+ * converted between text and binary and then checked against the graph and
+ * loaded into the support tables.
+ *
+ * Every node column must have one entry per node record, and every edge column
+ * one entry per edge record. The exceptions are nodeLines and edgeLines, which
+ * only exist for calls read from a file and may both be left empty for calls
+ * built in memory. Then records are loaded nodes first, and errors give the
+ * record number instead of the line.
+ */
+struct GlennCalls {
+    // For each node ("N") record, the node ID
+    std::vector<int64_t> nodeIds;
+    // The call type character ("R" for reference, "U" for uncalled, etc.)
+    std::vector<char> nodeCallTypes;
+    // Whether the support and likelihood columns were present
+    std::vector<uint8_t> nodeHasSupport;
+    // Forward and reverse strand read support
+    std::vector<double> nodeForwardSupport;
+    std::vector<double> nodeReverseSupport;
+    // Other support count
+    std::vector<int32_t> nodeOtherSupport;
+    // Likelihood
+    std::vector<double> nodeLikelihoods;
+    // Original node ID and offset this node came from, or 0 for the ID if it
+    // wasn't given
+    std::vector<int64_t> nodeOriginalIds;
+    std::vector<uint64_t> nodeOriginalOffsets;
+    // Line in the original text file the record came from, for error messages
+    // and to load records in file order. Empty if there was no file.
+    std::vector<uint64_t> nodeLines;
+    
+    // For each edge ("E") record, the from node and whether the edge leaves
+    // its start
+    std::vector<int64_t> edgeFroms;
+    std::vector<uint8_t> edgeFromStarts;
+    // The to node and whether the edge enters its end
+    std::vector<int64_t> edgeTos;
+    std::vector<uint8_t> edgeToEnds;
+    // The mode character ("L" or "R" for possible deletions, "." for anything
+    // else)
+    std::vector<char> edgeModes;
+    // Whether the support and likelihood columns were present
+    std::vector<uint8_t> edgeHasSupport;
+    // Forward and reverse strand read support
+    std::vector<double> edgeForwardSupport;
+    std::vector<double> edgeReverseSupport;
+    // Other support count
+    std::vector<int32_t> edgeOtherSupport;
+    // Likelihood
+    std::vector<double> edgeLikelihoods;
+    // Line in the original text file the record came from, or empty
+    std::vector<uint64_t> edgeLines;
+    
+    // How many lines were in the original text file
+    uint64_t lineCount = 0;
+    
+    /**
+     * Describe an edge record the way it appeared in the text file.
+     */
+    std::string edge_description(size_t i) const {
+        return std::to_string(edgeFroms[i]) + "," + std::to_string((int)edgeFromStarts[i]) + "," +
+            std::to_string(edgeTos[i]) + "," + std::to_string((int)edgeToEnds[i]);
+    }
+    
+    /**
+     * Say where node record i came from, for error messages.
+     */
+    std::string node_location(size_t i) const {
+        return nodeLines.empty() ? "Node record " + std::to_string(i + 1) : "Line " + std::to_string(nodeLines[i]);
+    }
+    
+    /**
+     * Say where edge record i came from, for error messages.
+     */
+    std::string edge_location(size_t i) const {
+        return edgeLines.empty() ? "Edge record " + std::to_string(i + 1) : "Line " + std::to_string(edgeLines[i]);
+    }
+    
+    /**
+     * Move all the records from another set of calls onto the end of this one.
+     */
+    void append(GlennCalls& other) {
+        append_column(nodeIds, other.nodeIds);
+        append_column(nodeCallTypes, other.nodeCallTypes);
+        append_column(nodeHasSupport, other.nodeHasSupport);
+        append_column(nodeForwardSupport, other.nodeForwardSupport);
+        append_column(nodeReverseSupport, other.nodeReverseSupport);
+        append_column(nodeOtherSupport, other.nodeOtherSupport);
+        append_column(nodeLikelihoods, other.nodeLikelihoods);
+        append_column(nodeOriginalIds, other.nodeOriginalIds);
+        append_column(nodeOriginalOffsets, other.nodeOriginalOffsets);
+        append_column(nodeLines, other.nodeLines);
+        append_column(edgeFroms, other.edgeFroms);
+        append_column(edgeFromStarts, other.edgeFromStarts);
+        append_column(edgeTos, other.edgeTos);
+        append_column(edgeToEnds, other.edgeToEnds);
+        append_column(edgeModes, other.edgeModes);
+        append_column(edgeHasSupport, other.edgeHasSupport);
+        append_column(edgeForwardSupport, other.edgeForwardSupport);
+        append_column(edgeReverseSupport, other.edgeReverseSupport);
+        append_column(edgeOtherSupport, other.edgeOtherSupport);
+        append_column(edgeLikelihoods, other.edgeLikelihoods);
+        append_column(edgeLines, other.edgeLines);
+        lineCount += other.lineCount;
+        other = GlennCalls();
+    }
+    
+private:
+    template<typename T>
+    static void append_column(std::vector<T>& dest, std::vector<T>& source) {
+        if(dest.empty()) {
+            dest.swap(source);
+        } else {
+            dest.insert(dest.end(), source.begin(), source.end());
+        }
+    }
+};
+
+/**
+ * Read a Glenn call file, in either text or binary format, handing the
+ * records to the given function in batches as they are read. Returns the
+ * number of lines in the original text file.
+ */
+uint64_t read_glenn_file(const std::string& glennFile, const std::function<void(GlennCalls&)>& handleBatch);
+
+/**
+ * Read a whole Glenn call file, in either text or binary format, into columns.
+ */
+GlennCalls read_glenn_file(const std::string& glennFile);
+
+/**
+ * Write Glenn calls out in the binary call format.
+ */
+void write_glenn_binary(const GlennCalls& calls, std::ostream& out);
+
+/**
+ * What we have decided about one sample at a site.
+ */
+struct SampleCall {
+    // The called allele numbers, or -1 if we can't make a call
+    int genotype[2] = {-1, -1};
+    // Read support for the ref and alt alleles
+    Support refSupport = std::make_pair(0.0, 0.0);
+    Support altSupport = std::make_pair(0.0, 0.0);
+    // Minimum likelihoods along the ref and alt alleles
+    double refLikelihood = LOG_ZERO;
+    double altLikelihood = LOG_ZERO;
+    // Phred-scaled quality of the genotype
+    double quality = 0;
+    // For reference blocks, the lowest depth at any base in the block
+    int64_t minDepth = 0;
+    
+    /**
+     * Get the total depth over both alleles.
+     */
+    int64_t depth() const {
+        return (int64_t)round(total(refSupport + altSupport));
+    }
+    
+    /**
+     * Set the genotype to the given pair of allele numbers.
+     */
+    void set_genotype(int first, int second) {
+        genotype[0] = first;
+        genotype[1] = second;
+    }
+    
+    /**
+     * Return true if the genotype is the given pair of allele numbers.
+     */
+    bool has_genotype(int first, int second) const {
+        return genotype[0] == first && genotype[1] == second;
+    }
+    
+    /**
+     * Get the genotype in VCF notation.
+     */
+    std::string genotype_string() const {
+        if(genotype[0] == -1) {
+            return "./.";
+        }
+        return std::to_string(genotype[0]) + "/" + std::to_string(genotype[1]);
+    }
+};
+
+/**
+ * Everything we have decided about a call at one site, kept as typed values
+ * until it is written out as VCF text or BCF.
+ */
+struct SiteCall {
+    // 1-based position of the first base of the ref allele
+    int64_t position = 0;
+    // Name for the variant
+    std::string id;
+    // The ref allele, with anything that isn't a base replaced by N
+    std::string ref;
+    // The alt alleles, cleaned up the same way
+    std::vector<std::string> alt;
+    // All the alleles by allele number, ref first
+    std::vector<std::string> alleles;
+    // Is the alt already present in the original graph?
+    bool known = false;
+    // Original graph node:offset cross-references, deduplicated and sorted
+    std::vector<std::pair<int64_t, size_t>> crossreferences;
+    // Phred-scaled quality: the best of the samples' genotype qualities
+    double quality = 0;
+    // For calls with a symbolic alt allele, the structural variant type, the
+    // 1-based last reference base covered, and the change in length.
+    std::string svType;
+    int64_t end = 0;
+    int64_t svLength = 0;
+    // The call for each sample, in output order
+    std::vector<SampleCall> samples;
+    // Is this a gVCF reference block, running through end, instead of a
+    // variant? Its samples' ref support is their average over the block.
+    bool referenceBlock = false;
+    
+    /**
+     * Get the total depth over all the samples.
+     */
+    int64_t depth() const {
+        int64_t depth = 0;
+        for(auto& sample : samples) {
+            depth += sample.depth();
+        }
+        return depth;
+    }
+};
+
+/**
+ * Settings for turning calls into a VCF, which can be shared by all the
+ * samples called against a graph.
+ */
+struct CallingOptions {
+    // What name should we give the contig in the VCF file?
+    std::string contigName;
+    // How far should we offset positions of variants?
+    int64_t variantOffset = 0;
+    // How many nodes should we be willing to look at on our path back to the
+    // primary path? Keep in mind we need to look at all valid paths (and all
+    // combinations thereof) until we find a valid pair.
+    int64_t maxDepth = 10;
+    // What should the total sequence length reported in the VCF header be?
+    int64_t lengthOverride = -1;
+    // What fraction of average coverage should be the minimum to call a variant (or a single copy)?
+    // Default to 0 because vg call is still applying depth thresholding
+    double minFractionForCall = 0;
+    // What fraction of the reads supporting an alt are we willing to discount?
+    // At 2, if twice the reads support one allele as the other, we'll call
+    // homozygous instead of heterozygous. At infinity, every call will be
+    // heterozygous if even one read supports each allele.
+    double maxHetBias = 20;
+    // Like above, but applied to ref / alt ratio (instead of alt / ref)
+    double maxRefBias = 20;
+    // What's the minimum integer number of reads that must support a call? We
+    // don't necessarily want to call a SNP as het because we have a single
+    // supporting read, even if there are only 10 reads on the site.
+    size_t minTotalSupportForCall = 2;
+    // Bin size used for counting coverage along the reference path.  The
+    // bin coverage is used for computing the probability of an allele
+    // of a certain depth
+    size_t refBinSize = 1000;
+    // On some graphs, we can't get the coverage because it's split over
+    // parallel paths.  Allow overriding here
+    size_t expCoverage = 0;
+    // How much work can we do finding a bubble at any one site? Each sample
+    // gets its own copy to count with.
+    SearchBudget searchBudget;
+    // Should we report how long each phase takes?
+    bool phaseTimes = false;
+    // Should we write BCF instead of VCF text?
+    bool writeBcf = false;
+    // Above what change in length should we use symbolic alleles? 0 means
+    // never.
+    int64_t svThreshold = 0;
+    // Should we trim and left-align alleles, so the output doesn't need a
+    // separate normalization pass?
+    bool normalize = false;
+    // Should we cover the reference between variants with gVCF reference
+    // blocks?
+    bool gvcf = false;
+    // Lowest depths of the depth bands for gVCF reference blocks. A block runs
+    // as long as every sample's depth stays in the same band.
+    std::vector<int64_t> gvcfBands = {1, 2, 3, 4, 5, 10, 20, 50, 100};
+};
+
+/**
+ * Everything one sample's Glenn file tells us about the graph, plus the
+ * coverage and pileups we need to genotype it.
+ */
+struct SampleSupport {
+    // What should the sample be called in the VCF file?
+    std::string name = "SAMPLE";
+    
+    // This holds read support, on each strand, for all the nodes we have read
+    // support provided for, by the node pointer in the vg graph.
+    std::map<vg::Node*, Support> nodeReadSupport;
+    // And read support for the edges
+    std::map<vg::Edge*, Support> edgeReadSupport;
+    // This maps the likelihood passed from the tsv to the nodes and edges
+    // (todo: could save some lookups by lumping with supports)
+    std::map<vg::Node*, double> nodeLikelihood;
+    std::map<vg::Edge*, double> edgeLikelihood;
+    
+    // This holds all the edges that are deletions in this sample, by the
+    // pointer to the stored Edge object in the VG graph
+    std::set<vg::Edge*> deletionEdges;
+    // This holds where nodes came from (node and offset) in the original, un-
+    // augmented graph. For pieces of original nodes, this is where the piece
+    // started. For novel nodes, this is where the piece that thois is an
+    // alternative to started.
+    std::map<vg::Node*, std::pair<int64_t, size_t>> nodeSources;
+    // We also need to track what edges and nodes are reference (i.e. already
+    // known)
+    std::set<vg::Node*> knownNodes;
+    std::set<vg::Edge*> knownEdges;
+    
+    // Average read support per base along the whole primary path
+    Support primaryPathAverageSupport = std::make_pair(0.0, 0.0);
+    // And in bins along it
+    std::vector<Support> binnedSupport;
+    
+    // Pileup records by node ID, if we have pileups
+    std::map<int64_t, vg::NodePileup> nodePileups;
+};
+
+/**
+ * Turn a call into a vcflib Variant in the given VCF file, on the given contig,
+ * for the given samples, which must be in the same order as the call's.
+ */
+vcflib::Variant to_variant(const SiteCall& call, vcflib::VariantCallFile& vcf,
+    const std::string& contigName, const std::vector<std::string>& sampleNames);
+
+/**
+ * Load a sample's pileups from a file of vg Pileup records, so its calls can
+ * be annotated with them. Throws std::runtime_error if the file can't be read.
+ */
+void load_pileups(SampleSupport& sample, const std::string& pileupFilename);
+
+class ThreadedOutputBuffer;
+
+/**
+ * Writes calls out, as either VCF text or BCF. VCF text goes through a
+ * ThreadedOutputBuffer. BCF is encoded by htslib straight from the typed
+ * values in the calls, so nothing gets formatted as text.
+ */
+class CallWriter {
+public:
+    /**
+     * Start writing to the given file ("-" for standard output), with the
+     * given VCF header text. The contig must be declared in the header if
+     * writing BCF.
+     */
+    CallWriter(const std::string& filename, const std::string& headerText, const std::string& contigName,
+        const std::vector<std::string>& sampleNames, bool bcf);
+    
+    ~CallWriter();
+    
+    /**
+     * Write out a call. If writing VCF text, the given pileup comment line
+     * goes after it. BCF has nowhere to put it.
+     */
+    void write(const SiteCall& call, const std::string& pileupLine);
+    
+    /**
+     * Finish writing everything. Returns false if anything could not be
+     * written.
+     */
+    bool close();
+    
+private:
+    /**
+     * Encode a call as a BCF record and write it.
+     */
+    void write_bcf(const SiteCall& call);
+
+    std::string contigName;
+    std::vector<std::string> sampleNames;
+    
+    // For VCF text output
+    vcflib::VariantCallFile vcf;
+    FILE* textFile = nullptr;
+    std::unique_ptr<ThreadedOutputBuffer> textBuffer;
+    std::unique_ptr<std::ostream> textStream;
+    
+    // For BCF output
+    htsFile* bcfFile = nullptr;
+    bcf_hdr_t* bcfHeader = nullptr;
+    bcf1_t* bcfRecord = nullptr;
+    int contigId = -1;
+    
+    // Set if anything could not be written
+    bool failed = false;
+};
+
+struct ReferenceIndex;
+class EdgeIndex;
+class SiteCatalog;
+
+/**
+ * Calls samples against one loaded graph and its reference path. Holds the
+ * reference and edge indexes, and optionally a site catalog, which are built
+ * once and then only read, so any number of samples can be called against
+ * them, at the same time if need be. The graph must outlive the caller.
+ */
+class GraphCaller {
+public:
+    /**
+     * Index the given graph's reference path with the given name. If
+     * packReference is set, store the reference sequence 2 bits per base. If
+     * refCacheFilename is set, load the index from there if it matches the
+     * graph, and save it there if not.
+     */
+    GraphCaller(vg::VG& graph, const std::string& refPathName, bool packReference = false,
+        const std::string& refCacheFilename = "");
+    
+    ~GraphCaller();
+    
+    /**
+     * Get the name of the reference path we call against.
+     */
+    const std::string& reference_path_name() const;
+    
+    /**
+     * Load the calls from a Glenn file, in text or binary format, into the
+     * given sample. Throws std::runtime_error if the file can't be read or
+     * doesn't match the graph.
+     */
+    void load_calls(SampleSupport& sample, const std::string& glennFile) const;
+    
+    /**
+     * Load calls that are already in memory into the given sample. Throws
+     * std::runtime_error if their columns don't all have the same length (see
+     * GlennCalls) or they don't match the graph.
+     */
+    void add_calls(SampleSupport& sample, const GlennCalls& calls) const;
+    
+    /**
+     * Find the bubble for every non-reference node in the graph, searching to
+     * the given depth and within the given budget for each, so calling can
+     * look them up instead of searching.
+     */
+    void make_catalog(int64_t maxDepth, const SearchBudget& budget);
+    
+    /**
+     * Save the site catalog to the given binary stream.
+     */
+    void save_catalog(std::ostream& out) const;
+    
+    /**
+     * Load a site catalog from the given binary stream. Throws
+     * std::runtime_error if it was not made for this graph and reference path.
+     */
+    void load_catalog(std::istream& in);
+    
+    /**
+     * Get the number of sites in the site catalog, or 0 if there isn't one.
+     */
+    size_t catalog_size() const;
+    
+    /**
+     * Make the VCF header text for calls on the given samples with the given
+     * options.
+     */
+    std::string vcf_header(const std::vector<std::string>& sampleNames, const CallingOptions& options) const;
+    
+    /**
+     * Find the sites where any of the given samples has support, genotype
+     * every sample at each of them, and hand each call to emit, in VCF order,
+     * along with any pileup comment lines for it. In gVCF mode, reference
+     * blocks are handed over too, between the variants, and everything comes
+     * out sorted by position. The samples' coverage is filled in along the
+     * way. If skippedBed is set, sites that run out of
+     * search budget are reported to it in BED format.
+     */
+    void call(std::vector<SampleSupport>& samples, const CallingOptions& options,
+        const std::function<void(const SiteCall&, const std::string&)>& emit,
+        std::ostream* skippedBed = nullptr) const;
+    
+private:
+    vg::VG& graph;
+    std::string refPathName;
+    std::unique_ptr<ReferenceIndex> referenceIndex;
+    std::unique_ptr<EdgeIndex> edgeIndex;
+    // Bubbles we can look up instead of searching for, if any
+    std::unique_ptr<SiteCatalog> catalog;
+};
+
+#endif
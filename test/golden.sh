@@ -0,0 +1,175 @@
+#!/usr/bin/env bash
+# golden.sh: check that glenn2vcf still makes the same calls.
+#
+# Usage: test/golden.sh
+#
+# Runs glenn2vcf on every example graph and call file pair, on some larger
+# generated cases, and on the generated cases with various options, and
+# compares the VCF records (header dropped, sorted) against the expectations
+# stored in test/expected. Reports how fast each case ran alongside whether it
+# passed. If glenn2vcf exits with an error on a case, the exit status is
+# recorded as part of the case's output, so expected failures are checked
+# like anything else. A crash always fails, and is never blessed.
+#
+# Environment variables:
+#   GLENN2VCF   glenn2vcf binary to test (default ./glenn2vcf)
+#   VG          vg binary used to convert graphs from JSON (default ekg/vg/bin/vg)
+#   BCFTOOLS    bcftools binary used to read BCF output (default bcftools); the
+#               BCF case is skipped if it can't be run
+#   WORK        where to put outputs and generated inputs (default test/work)
+#   BLESS       if set to 1, store the current outputs as the new expectations
+#               instead of checking them
+
+set -e
+
+cd "$(dirname "$0")/.."
+
+GLENN2VCF="${GLENN2VCF:-./glenn2vcf}"
+VG="${VG:-ekg/vg/bin/vg}"
+BCFTOOLS="${BCFTOOLS:-bcftools}"
+WORK="${WORK:-test/work}"
+BLESS="${BLESS:-0}"
+EXPECTED="test/expected"
+
+# Generated cases, as sites:seed
+GENERATED_CASES="1000:1 10000:2"
+
+mkdir -p "${WORK}" "${EXPECTED}"
+
+PASSED=0
+FAILED=0
+
+# Run one case, named $1. The rest of the arguments are passed to glenn2vcf
+# after "-r ref". Standard input comes from CASE_INPUT, if set.
+function run_case {
+    local NAME="$1"
+    shift
+    local OUTPUT="${WORK}/${NAME}.vcf"
+
+    local START=$(date +%s.%N)
+    local STATUS=0
+    "${GLENN2VCF}" -r ref "$@" < "${CASE_INPUT:-/dev/null}" > "${WORK}/${NAME}.raw.vcf" 2> "${WORK}/${NAME}.log" || STATUS=$?
+    local END=$(date +%s.%N)
+
+    # Normalize the output, so header changes and emission order don't matter
+    grep -v '^#' "${WORK}/${NAME}.raw.vcf" | LC_ALL=C sort > "${OUTPUT}" || true
+    if [ "${STATUS}" != "0" ]; then
+        # Failing is part of the behavior we are checking, so record it too
+        echo "glenn2vcf failed with exit status ${STATUS}" >> "${OUTPUT}"
+    fi
+
+    local RECORDS=$(wc -l < "${OUTPUT}")
+    local SPEED=$(awk -v start="${START}" -v end="${END}" -v records="${RECORDS}" \
+        'BEGIN { seconds = end - start; printf "%.3f s, %.0f records/s", seconds, (seconds > 0 ? records / seconds : 0) }')
+
+    if [ "${STATUS}" -gt 128 ]; then
+        # Killed by a signal. That's never the right answer.
+        printf "FAIL\t%s\tcrashed with exit status %d; see %s\n" "${NAME}" "${STATUS}" "${WORK}/${NAME}.log"
+        FAILED=$((FAILED + 1))
+    elif [ "${BLESS}" == "1" ]; then
+        cp "${OUTPUT}" "${EXPECTED}/${NAME}.vcf"
+        printf "BLESS\t%s\t%d records\t%s\n" "${NAME}" "${RECORDS}" "${SPEED}"
+    elif [ ! -e "${EXPECTED}/${NAME}.vcf" ]; then
+        printf "FAIL\t%s\tno expected output; run with BLESS=1 to record it\n" "${NAME}"
+        FAILED=$((FAILED + 1))
+    elif cmp -s "${OUTPUT}" "${EXPECTED}/${NAME}.vcf"; then
+        printf "PASS\t%s\t%d records\t%s\n" "${NAME}" "${RECORDS}" "${SPEED}"
+        PASSED=$((PASSED + 1))
+    else
+        printf "FAIL\t%s\toutput differs; see diff %s %s and %s\n" "${NAME}" \
+            "${EXPECTED}/${NAME}.vcf" "${OUTPUT}" "${WORK}/${NAME}.log"
+        FAILED=$((FAILED + 1))
+    fi
+}
+
+# Make sure graph $1 exists, converting it from $2, a graph in JSON.
+function convert_graph {
+    if [ ! -e "$1" ]; then
+        "${VG}" view -Jv "$2" > "$1"
+    fi
+}
+
+# Run every example call file against the graph it goes with. The graphs are
+# built from their JSON, like the generated ones.
+for CALLS in examples/*.tsv; do
+    NAME="$(basename "${CALLS}" .tsv)"
+    GRAPH="${WORK}/example_${NAME%%_*}.vg"
+    convert_graph "${GRAPH}" "examples/${NAME%%_*}.json"
+    run_case "${NAME}" "${GRAPH}" "${CALLS}"
+done
+
+# And the generated cases
+for CASE in ${GENERATED_CASES}; do
+    SITES="${CASE%%:*}"
+    SEED="${CASE##*:}"
+    NAME="generated_sites${SITES}_seed${SEED}"
+    if [ ! -e "${WORK}/${NAME}.tsv" ]; then
+        python3 bench/generate.py --sites "${SITES}" --seed "${SEED}" "${WORK}/${NAME}" 2> /dev/null
+    fi
+    convert_graph "${WORK}/${NAME}.vg" "${WORK}/${NAME}.json"
+    run_case "${NAME}" "${WORK}/${NAME}.vg" "${WORK}/${NAME}.tsv"
+done
+
+# The options are tried on the smaller generated case.
+GRAPH="${WORK}/generated_sites1000_seed1.vg"
+CALLS="${WORK}/generated_sites1000_seed1.tsv"
+
+# Large replacements have to keep their sequence when the length change is
+# big enough for symbolic alleles; only pure indels become <DEL>/<INS>.
+run_case "sv_threshold" -S 3 "${GRAPH}" "${CALLS}"
+
+# gVCF reference blocks have to tile the reference, and must not claim the
+# reference where a site was given up on.
+run_case "gvcf" -g -e 20 "${GRAPH}" "${CALLS}"
+
+run_case "normalize" -N "${GRAPH}" "${CALLS}"
+
+# Looking sites up in a catalog has to make the same calls as searching for
+# them.
+"${GLENN2VCF}" -r ref -m "${WORK}/catalog.cat" "${GRAPH}" 2> "${WORK}/catalog.log"
+run_case "catalog" -a "${WORK}/catalog.cat" "${GRAPH}" "${CALLS}"
+
+# Two samples, where the second has less support on some of the nodes and
+# edges.
+awk 'BEGIN { OFS = "\t" } NR % 3 == 0 && NF >= 5 { $4 = int($4 / 4); $5 = int($5 / 4) } { print }' \
+    "${CALLS}" > "${WORK}/second_sample.tsv"
+run_case "multi_sample" -s first -s second "${GRAPH}" "${CALLS}" "${WORK}/second_sample.tsv"
+
+# Calls read from standard input have to come out the same as from a file.
+CASE_INPUT="${CALLS}" run_case "stdin" "${GRAPH}" -
+
+# A gzipped call file that was cut off partway through has to fail, not look
+# like a shorter file.
+NAME="truncated_gzip"
+if [ ! -e "${WORK}/${NAME}.tsv.gz" ]; then
+    gzip -c "${CALLS}" > "${WORK}/${NAME}.full.tsv.gz"
+    head -c $(($(wc -c < "${WORK}/${NAME}.full.tsv.gz") / 2)) "${WORK}/${NAME}.full.tsv.gz" > "${WORK}/${NAME}.tsv.gz"
+fi
+run_case "${NAME}" "${GRAPH}" "${WORK}/${NAME}.tsv.gz"
+
+# BCF output has to hold the same records as VCF output. Both are read back
+# through bcftools, so number formatting doesn't matter.
+if "${BCFTOOLS}" --version > /dev/null 2>&1; then
+    "${GLENN2VCF}" -r ref -c ref -O "${GRAPH}" "${CALLS}" > "${WORK}/bcf.bcf" 2> "${WORK}/bcf.log"
+    "${GLENN2VCF}" -r ref -c ref "${GRAPH}" "${CALLS}" 2> /dev/null | "${BCFTOOLS}" view -H | LC_ALL=C sort > "${WORK}/bcf.expected.vcf"
+    "${BCFTOOLS}" view -H "${WORK}/bcf.bcf" | LC_ALL=C sort > "${WORK}/bcf.vcf"
+    if [ "${BLESS}" == "1" ]; then
+        printf "SKIP\tbcf\tcompared with VCF output, nothing to bless\n"
+    elif cmp -s "${WORK}/bcf.vcf" "${WORK}/bcf.expected.vcf"; then
+        printf "PASS\tbcf\t%d records\n" "$(wc -l < "${WORK}/bcf.vcf")"
+        PASSED=$((PASSED + 1))
+    else
+        printf "FAIL\tbcf\tBCF records differ from VCF; see diff %s %s\n" "${WORK}/bcf.expected.vcf" "${WORK}/bcf.vcf"
+        FAILED=$((FAILED + 1))
+    fi
+else
+    printf "SKIP\tbcf\tcan't run %s\n" "${BCFTOOLS}"
+fi
+
+if [ "${BLESS}" != "1" ]; then
+    echo "${PASSED} passed, ${FAILED} failed"
+fi
+
+if [ "${FAILED}" != "0" ]; then
+    exit 1
+fi